@@ -0,0 +1,99 @@
+// Static SRAM arenas
+//
+// Buffers which need SRAM are allocated from fixed arenas instead of ad hoc globals, so their
+// placement is explicit and the budget is visible:
+//
+//   arena_main       SRAM0-7 (striped, .bss)     packet ring, row staging, packed cache
+//   arena_scratch_x  SRAM8 (a 4KB bank of its own, .scratch_x)
+//                    per-line state of core0; the top half is the core1 stack (core1 is not used)
+//
+// Allocations are named and stay until reset, except inside an arena_scope (temporary buffers such
+// as the staging rows of the self benchmark), which rolls the arena back when it ends.
+// An arena which is full is fatal (hal_panic), so a feature cannot silently exhaust SRAM.
+// arena_dump prints usage and high-water marks with the other reports; sram_map.py prints the
+// build-time map of the ELF (arenas, static buffers such as telemetry, stacks and heap per bank).
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "hal.h"
+
+#if OREORE_SIM
+#define ARENA_SCRATCH_X
+#else
+#define ARENA_SCRATCH_X __attribute__((section(".scratch_x.arena")))
+#endif
+
+const uint32_t ARENA_MAIN_BYTES = 16 * 1024;
+const uint32_t ARENA_SCRATCH_X_BYTES = 2 * 1024;    // PICO_CORE1_STACK_SIZE (2KB) is above
+const uint32_t ARENA_MAX_REGIONS = 8;
+
+struct arena_region {
+    const char * name;
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct arena {
+    const char * name;
+    uint8_t * base;
+    uint32_t size;
+    uint32_t used = 0;
+    uint32_t high_water = 0;
+    uint32_t num_regions = 0;
+    arena_region regions[ARENA_MAX_REGIONS] = {};
+
+    void * alloc(const char * region, const uint32_t bytes, const uint32_t align){
+        const uint32_t offset = (used + align - 1) & ~(align - 1);
+        if(offset + bytes > size || num_regions >= ARENA_MAX_REGIONS){
+            hal_panic("arena %s: no room for %s (%lu bytes, %lu used)", name, region,
+                (unsigned long)bytes, (unsigned long)used);
+        }
+        regions[num_regions++] = {region, offset, bytes};
+        used = offset + bytes;
+        if(high_water < used){
+            high_water = used;
+        }
+        return base + offset;
+    }
+
+    template<typename T>
+    T * alloc(const char * region, const uint32_t count = 1){
+        return static_cast<T *>(alloc(region, sizeof(T) * count, alignof(T)));
+    }
+};
+
+// Allocations in the scope are released when it ends (high_water keeps them)
+struct arena_scope {
+    arena & a;
+    const uint32_t used;
+    const uint32_t num_regions;
+
+    explicit arena_scope(arena & a_) : a(a_), used(a_.used), num_regions(a_.num_regions) {
+    }
+    ~arena_scope(){
+        a.used = used;
+        a.num_regions = num_regions;
+    }
+};
+
+// inline: one instance for every translation unit which includes this header
+alignas(8) inline uint8_t arena_main_mem[ARENA_MAIN_BYTES];
+alignas(8) ARENA_SCRATCH_X inline uint8_t arena_scratch_x_mem[ARENA_SCRATCH_X_BYTES];
+
+inline arena arena_main{"main", arena_main_mem, ARENA_MAIN_BYTES};
+inline arena arena_scratch_x{"scratch_x", arena_scratch_x_mem, ARENA_SCRATCH_X_BYTES};
+
+inline void arena_dump(){
+    printf("# sram arenas\n");
+    printf("arena,region,offset,bytes\n");
+    for(const arena * a : {&arena_main, &arena_scratch_x}){
+        for(uint32_t r=0;r<a->num_regions;r++){
+            const auto & g = a->regions[r];
+            printf("%s,%s,%lu,%lu\n", a->name, g.name, (unsigned long)g.offset, (unsigned long)g.size);
+        }
+        printf("# arena %s used=%lu high_water=%lu size=%lu (%lu%%)\n", a->name, (unsigned long)a->used,
+            (unsigned long)a->high_water, (unsigned long)a->size, (unsigned long)(a->high_water * 100 / a->size));
+    }
+}
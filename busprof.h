@@ -0,0 +1,176 @@
+// Bus contention profiler
+//
+// Enabled by OREORE_BUSPROF (cmake -DOREORE_BUSPROF=ON).
+// BUSCTRL has 4 performance counters. They are programmed with one event group at a time,
+// and the group is rotated every BUSPROF_WINDOW lines. Each window also keeps pack time
+// and slack of its lines, so contention can be compared with line timing.
+//
+// The window only runs in RUN: WAIT and HALT stop it (BUSPROF_IDLE) and the partial window is dropped,
+// so idle traffic of the blank lines and polls is not mixed into the line numbers.
+//
+// Counters are per bus slave (SRAM banks, XIP, APB, fast peripherals incl. PIO FIFOs).
+// Per master numbers are available for SIO only (proc0 / proc1).
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if OREORE_BUSPROF
+
+#include "hardware/structs/busctrl.h"
+
+// PERFSEL encoding of RP2350 (datasheet, BUSCTRL PERFSEL0)
+// Each slave has 4 events: stall_upstream, stall_downstream, access_contested, access
+enum busprof_slave {
+    BUSPROF_SIOB_PROC1 = 0, BUSPROF_SIOB_PROC0, BUSPROF_APB, BUSPROF_FASTPERI,
+    BUSPROF_SRAM9, BUSPROF_SRAM8, BUSPROF_SRAM7, BUSPROF_SRAM6, BUSPROF_SRAM5,
+    BUSPROF_SRAM4, BUSPROF_SRAM3, BUSPROF_SRAM2, BUSPROF_SRAM1, BUSPROF_SRAM0,
+    BUSPROF_XIP_MAIN1, BUSPROF_XIP_MAIN0, BUSPROF_ROM
+};
+enum busprof_kind {
+    BUSPROF_STALL_UPSTREAM = 0, BUSPROF_STALL_DOWNSTREAM, BUSPROF_CONTESTED, BUSPROF_ACCESS
+};
+
+struct busprof_event {
+    const char * name;
+    uint8_t slave;
+    uint8_t kind;
+
+    uint32_t sel() const {
+        return slave * 4 + kind;
+    }
+};
+
+const uint32_t BUSPROF_COUNTERS = 4;
+const uint32_t BUSPROF_WINDOW = 64; // lines
+
+const busprof_event busprof_groups[][BUSPROF_COUNTERS] = {
+    {{"xip0_contested", BUSPROF_XIP_MAIN0, BUSPROF_CONTESTED}, {"xip1_contested", BUSPROF_XIP_MAIN1, BUSPROF_CONTESTED},
+     {"xip0_access", BUSPROF_XIP_MAIN0, BUSPROF_ACCESS},       {"xip1_access", BUSPROF_XIP_MAIN1, BUSPROF_ACCESS}},
+    {{"sram0_contested", BUSPROF_SRAM0, BUSPROF_CONTESTED},    {"sram1_contested", BUSPROF_SRAM1, BUSPROF_CONTESTED},
+     {"sram2_contested", BUSPROF_SRAM2, BUSPROF_CONTESTED},    {"sram3_contested", BUSPROF_SRAM3, BUSPROF_CONTESTED}},
+    {{"sram4_contested", BUSPROF_SRAM4, BUSPROF_CONTESTED},    {"sram5_contested", BUSPROF_SRAM5, BUSPROF_CONTESTED},
+     {"sram6_contested", BUSPROF_SRAM6, BUSPROF_CONTESTED},    {"sram7_contested", BUSPROF_SRAM7, BUSPROF_CONTESTED}},
+    {{"sram8_contested", BUSPROF_SRAM8, BUSPROF_CONTESTED},    {"sram9_contested", BUSPROF_SRAM9, BUSPROF_CONTESTED},
+     {"fastperi_contested", BUSPROF_FASTPERI, BUSPROF_CONTESTED}, {"apb_contested", BUSPROF_APB, BUSPROF_CONTESTED}},
+    {{"proc0_contested", BUSPROF_SIOB_PROC0, BUSPROF_CONTESTED}, {"proc1_contested", BUSPROF_SIOB_PROC1, BUSPROF_CONTESTED},
+     {"xip0_stall_down", BUSPROF_XIP_MAIN0, BUSPROF_STALL_DOWNSTREAM}, {"sram0_stall_down", BUSPROF_SRAM0, BUSPROF_STALL_DOWNSTREAM}},
+};
+const uint32_t BUSPROF_GROUPS = sizeof(busprof_groups) / sizeof(busprof_groups[0]);
+
+struct busprof_result {
+    uint32_t windows;
+    uint64_t count[BUSPROF_COUNTERS];
+    uint32_t max[BUSPROF_COUNTERS];    // max count in a window
+    uint64_t pack_us;                   // sum of fetch + pack time
+    uint32_t pack_max_us;
+    uint32_t slack_min_us;
+    uint32_t lines;
+};
+
+struct busprof {
+    busprof_result results[BUSPROF_GROUPS] = {};
+    uint32_t group = 0;
+    uint32_t lines = 0;
+    uint64_t pack_us = 0;
+    uint32_t pack_max_us = 0;
+    uint32_t slack_min_us = UINT32_MAX;
+    bool idle = false;
+
+    void program(){
+        bus_ctrl_hw->perf_ctr_en = 0;
+        for(uint32_t i=0;i<BUSPROF_COUNTERS;i++){
+            bus_ctrl_hw->counter[i].sel = busprof_groups[group][i].sel();
+            bus_ctrl_hw->counter[i].value = 0; // write clears
+        }
+        lines = 0;
+        pack_us = 0;
+        pack_max_us = 0;
+        slack_min_us = UINT32_MAX;
+        idle = false;
+        bus_ctrl_hw->perf_ctr_en = 1;
+    }
+
+    // Leaving RUN: stop counting, the window restarts on the next line
+    void stop(){
+        bus_ctrl_hw->perf_ctr_en = 0;
+        idle = true;
+    }
+
+    void resume(){
+        if(idle){
+            program();
+        }
+    }
+
+    void line(const uint32_t pack, const int32_t slack){
+        lines++;
+        pack_us += pack;
+        if(pack_max_us < pack){
+            pack_max_us = pack;
+        }
+        const uint32_t s = slack > 0 ? slack : 0;
+        if(s < slack_min_us){
+            slack_min_us = s;
+        }
+        if(lines < BUSPROF_WINDOW){
+            return;
+        }
+
+        auto & r = results[group];
+        for(uint32_t i=0;i<BUSPROF_COUNTERS;i++){
+            const uint32_t v = bus_ctrl_hw->counter[i].value;
+            r.count[i] += v;
+            if(r.max[i] < v){
+                r.max[i] = v;
+            }
+        }
+        if(r.windows == 0 || r.slack_min_us > slack_min_us){
+            r.slack_min_us = slack_min_us;
+        }
+        if(r.pack_max_us < pack_max_us){
+            r.pack_max_us = pack_max_us;
+        }
+        r.pack_us += pack_us;
+        r.lines += lines;
+        r.windows++;
+
+        group = (group + 1) % BUSPROF_GROUPS;
+        program();
+    }
+};
+
+busprof bus_prof;
+
+void busprof_dump(){
+    printf("# bus contention (window=%lu lines)\n", (unsigned long)BUSPROF_WINDOW);
+    printf("event,windows,avg_per_window,max_per_window,pack_avg_us,pack_max_us,slack_min_us\n");
+    for(uint32_t g=0;g<BUSPROF_GROUPS;g++){
+        const auto & r = bus_prof.results[g];
+        if(r.windows == 0){
+            continue;
+        }
+        for(uint32_t i=0;i<BUSPROF_COUNTERS;i++){
+            printf("%s,%lu,%lu,%lu,%lu,%lu,%lu\n", busprof_groups[g][i].name, (unsigned long)r.windows,
+                (unsigned long)(r.count[i] / r.windows), (unsigned long)r.max[i],
+                (unsigned long)(r.pack_us / r.lines), (unsigned long)r.pack_max_us, (unsigned long)r.slack_min_us);
+        }
+    }
+}
+
+#define BUSPROF_INIT() bus_prof.program()
+#define BUSPROF_RESUME() bus_prof.resume()
+#define BUSPROF_LINE(pack_us, slack_us) bus_prof.line((pack_us), (slack_us))
+#define BUSPROF_IDLE() bus_prof.stop()
+#define BUSPROF_DUMP() busprof_dump()
+
+#else
+
+#define BUSPROF_INIT() ((void)0)
+#define BUSPROF_RESUME() ((void)0)
+#define BUSPROF_LINE(pack_us, slack_us) ((void)0)
+#define BUSPROF_IDLE() ((void)0)
+#define BUSPROF_DUMP() ((void)0)
+
+#endif
@@ -0,0 +1,184 @@
+# capacity_model.py
+# This script estimates line rate, CPU load and memory budgets of a hardware configuration
+# from measured pack costs, before the hardware is built.
+
+# Usage
+# 1. Measure pack costs
+#   host:   $ ./build-sim/oreore_sim bench > bench.csv
+#           (host ns are converted to the device by --host-scale)
+#   device: bench mode of the firmware prints the same CSV (use --host-scale 1)
+# 2. Run the model with the configuration to plan
+# $ python ./capacity_model.py --bench bench.csv --host-scale 25
+# $ python ./capacity_model.py --bench bench.csv --host-scale 25 --length 120 --lanes 4 --period-us 3000
+#
+# Images are read from oreore_poi.cpp (image_info definitions) and the image headers,
+# or given by --image NAME:WIDTH:HEIGHT[:PERIOD_US[:MULTILINE]] (WIDTH in pixels).
+# The packet ring size (--buffers) defaults to PACKET_BUFFERS of poi.h.
+
+import argparse
+import csv
+import math
+import os
+import re
+import sys
+
+REPO = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_PERIOD_US = 2500
+BENCH_LENGTH = 80       # LENGTH of the build which produced the bench CSV
+
+def parse_poi_constant(name, default):
+  # const uint32_t NAME = VALUE; in poi.h
+  m = re.search(r'const\s+uint\d+_t\s+%s\s*=\s*(\d+)\s*;' % name, open(os.path.join(REPO, 'poi.h')).read())
+  return int(m.group(1)) if m else default
+
+def parse_image_headers():
+  # constexpr uint8_t NAME[HEIGHT][WIDTH * 3] = {
+  decl = re.compile(r'constexpr\s+uint8_t\s+(\w+)\s*\[(\d+)\]\s*\[(\d+)\]')
+  sizes = {}
+  for name in os.listdir(REPO):
+    if not name.endswith('.h'):
+      continue
+    with open(os.path.join(REPO, name)) as f:
+      for line in f:
+        m = decl.search(line)
+        if m:
+          sizes[m.group(1)] = (int(m.group(3)) // 3, int(m.group(2)))
+  return sizes
+
+def parse_images():
+  sizes = parse_image_headers()
+  src = open(os.path.join(REPO, 'oreore_poi.cpp')).read()
+  # image_info info_x(IMG(x), WID(x), HEI(x), period, loop, mirror, multiline);
+  images = []
+  for m in re.finditer(r'image_info\s+info_\w+\(IMG\((\w+)\),\s*WID\(\w+\),\s*HEI\(\w+\)(.*?)\);', src):
+    name = m.group(1)
+    args = [a.strip() for a in m.group(2).split(',') if a.strip()]
+    period = DEFAULT_PERIOD_US
+    if len(args) >= 1:
+      period = eval(args[0].replace('DEFAULT_PERIOD_us', str(DEFAULT_PERIOD_US)), {})
+    mirror = len(args) >= 3 and args[2] == 'true'
+    multiline = len(args) < 4 or args[3] == 'true'
+    width, height = sizes[name]
+    images.append({'name': name, 'width': width, 'height': height, 'period_us': period,
+                   'mirror': mirror, 'multiline': multiline})
+  return images
+
+def parse_image_arg(s):
+  v = s.split(':')
+  if len(v) < 3:
+    sys.exit('--image NAME:WIDTH:HEIGHT[:PERIOD_US[:MULTILINE]]')
+  return {'name': v[0], 'width': int(v[1]), 'height': int(v[2]),
+          'period_us': int(v[3]) if len(v) > 3 else DEFAULT_PERIOD_US,
+          'mirror': False, 'multiline': len(v) <= 4 or v[4] in ('1', 'true')}
+
+def read_bench(path):
+  # kernel,image,ns_per_line
+  costs = {}
+  with open(path) as f:
+    for row in csv.DictReader(line for line in f if not line.startswith('#')):
+      costs[(row['kernel'], row['image'])] = float(row['ns_per_line'])
+  return costs
+
+def pack_cost_us(costs, kernel, image, scale, length):
+  if (kernel, image) in costs:
+    ns = costs[(kernel, image)]
+  else:
+    # images not in the bench: average of the kernel
+    values = [v for (k, _), v in costs.items() if k == kernel]
+    if not values:
+      return None
+    ns = sum(values) / len(values)
+  return ns * scale * length / BENCH_LENGTH / 1000
+
+def main():
+  p = argparse.ArgumentParser(description='Line rate / CPU / memory capacity model')
+  p.add_argument('--bench', help='CSV of oreore_sim bench or the device bench mode')
+  p.add_argument('--host-scale', type=float, default=1.0, help='device time / bench time')
+  p.add_argument('--length', type=int, default=80, help='LEDs per strip')
+  p.add_argument('--lanes', type=int, default=3, help='strips driven in parallel')
+  p.add_argument('--bits-per-led', type=int, default=24, help='24: RGB, 32: RGBW')
+  p.add_argument('--bitrate', type=float, default=800000, help='LED bit rate [bit/s]')
+  p.add_argument('--reset-us', type=float, default=50, help='reset time (WS2812B V5: 280)')
+  p.add_argument('--arm-us', type=float, default=5, help='fetch + DMA trigger overhead per line')
+  p.add_argument('--period-us', type=float, help='override period of all images')
+  p.add_argument('--buffers', type=int, default=parse_poi_constant('PACKET_BUFFERS', 2),
+                 help='packet buffers (2: pack overlaps DMA safely), default PACKET_BUFFERS of poi.h')
+  p.add_argument('--flash-kb', type=int, default=2048)
+  p.add_argument('--code-kb', type=int, default=96, help='flash used by code and SDK')
+  p.add_argument('--sram-kb', type=int, default=520)
+  p.add_argument('--sram-used-kb', type=int, default=24, help='SRAM used by SDK, stacks and instrumentation')
+  p.add_argument('--image', action='append', type=parse_image_arg, help='NAME:WIDTH:HEIGHT[:PERIOD_US[:MULTILINE]]')
+  args = p.parse_args()
+
+  images = args.image if args.image else parse_images()
+  costs = read_bench(args.bench) if args.bench else {}
+
+  # PIO sends one bit of every lane per cycle (4 lanes per nibble, 8 lanes per byte)
+  pio_lanes = 4 if args.lanes <= 4 else 8
+  if args.lanes > 8:
+    sys.exit('more than 8 lanes need more than one state machine')
+  words = math.ceil(args.length * args.bits_per_led * pio_lanes / 32)
+  transfer_us = args.length * args.bits_per_led / args.bitrate * 1e6
+  frame_us = transfer_us + args.reset_us
+
+  print('# config length=%d lanes=%d bits_per_led=%d bitrate=%.0f reset=%.0fus' %
+        (args.length, args.lanes, args.bits_per_led, args.bitrate, args.reset_us))
+  print('# line: %d words, transfer %.1fus + reset %.0fus = %.1fus, max line rate %.0f lines/s' %
+        (words, transfer_us, args.reset_us, frame_us, 1e6 / frame_us))
+  if not costs:
+    print('# no --bench: pack cost is unknown, CPU columns are empty')
+
+  print('image,kernel,period_us,pack_us,min_period_us,max_line_rate,cpu_load,dma_margin_us,status')
+  failed = 0
+  for img in images:
+    period = args.period_us if args.period_us else img['period_us']
+    kernels = ['pack_parallel_sft', 'pack_parallel_sft_reverse'] if img['multiline'] else ['pack_parallel']
+    for kernel in kernels:
+      pack = pack_cost_us(costs, kernel, img['name'], args.host_scale, args.length) if costs else None
+      work = pack + args.arm_us if pack is not None else None
+      # Single buffer: the packet can be rewritten only after DMA has sent it.
+      # Double buffer: pack of the next line overlaps DMA.
+      if work is None:
+        min_period = frame_us
+      elif args.buffers >= 2:
+        min_period = max(frame_us, work)
+      else:
+        min_period = frame_us + work
+      margin = period - frame_us
+      status = []
+      if margin < 0:
+        status.append('dma_overrun')
+      if work is not None and work > period:
+        status.append('pack_overrun')
+      if min_period > period:
+        status.append('period_too_short')
+      if status:
+        failed += 1
+      print('%s,%s,%.0f,%s,%.1f,%.0f,%s,%.1f,%s' % (
+        img['name'], kernel, period,
+        '%.1f' % pack if pack is not None else '',
+        min_period, 1e6 / min_period,
+        '%.1f%%' % (work / period * 100) if work is not None else '',
+        margin, '+'.join(status) if status else 'ok'))
+
+  # Memory budgets
+  image_bytes = sum(img['width'] * img['height'] * 3 for img in images)
+  flash_used = image_bytes + args.code_kb * 1024
+  packet_bytes = words * 4 * args.buffers
+  sram_used = packet_bytes + args.sram_used_kb * 1024
+  print('# flash: images %.1fKB + code %dKB = %.1fKB / %dKB (%.1f%%)' %
+        (image_bytes / 1024, args.code_kb, flash_used / 1024, args.flash_kb, flash_used / 1024 / args.flash_kb * 100))
+  print('# sram: packets %dB x %d + other %dKB = %.1fKB / %dKB (%.1f%%)' %
+        (words * 4, args.buffers, args.sram_used_kb, sram_used / 1024, args.sram_kb, sram_used / 1024 / args.sram_kb * 100))
+  remaining_lines = (args.flash_kb * 1024 - flash_used) // (args.length * args.lanes * 3)
+  print('# flash left for %d more lines (%.1fs at %.0fus/line)' %
+        (max(0, remaining_lines), max(0, remaining_lines) * (args.period_us or DEFAULT_PERIOD_US) / 1e6,
+         args.period_us or DEFAULT_PERIOD_US))
+  if flash_used > args.flash_kb * 1024 or sram_used > args.sram_kb * 1024:
+    failed += 1
+    print('# memory budget exceeded')
+
+  sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+  main()
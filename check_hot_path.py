@@ -0,0 +1,139 @@
+# check_hot_path.py
+# This script checks the OREORE_RAM_HOT_PATH build of oreore_poi: every function marked HAL_HOT_FUNC
+# and every variable marked HAL_HOT_DATA must be in SRAM, and nothing reachable from them may branch
+# to flash (directly or through a long-branch veneer). Runs after link when the option is enabled.
+
+# Usage
+# $ python ./check_hot_path.py build/oreore_poi.elf
+# $ python ./check_hot_path.py build/oreore_poi.elf --objdump arm-none-eabi-objdump --verbose
+#
+# Hot functions / data are read from the HAL_HOT_FUNC(name) / HAL_HOT_DATA(name) markers in the sources.
+# Direct calls and tail calls are followed into other SRAM functions (SDK ones too).
+# Indirect calls (blx rN, IRQ dispatch) cannot be resolved and are only counted.
+# Tools are arm-none-eabi-objdump / nm (set TOOLCHAIN_PREFIX to override the prefix).
+# Exit code is 1 if a hot symbol is in flash or the hot path reaches flash.
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+REPO = os.path.dirname(os.path.abspath(__file__))
+PREFIX = os.environ.get('TOOLCHAIN_PREFIX', 'arm-none-eabi-')
+
+FLASH = (0x10000000, 0x20000000)    # XIP (cached and uncached aliases)
+SRAM = (0x20000000, 0x20082000)
+
+def in_range(addr, r):
+  return r[0] <= addr < r[1]
+
+def base_name(symbol):
+  # "pack_parallel(unsigned char const*) [clone .part.0]+0x1c" -> "pack_parallel"
+  # "void pack_parallel<led_ws2812>(unsigned int (&) [240], ...)" -> "pack_parallel"
+  name = re.sub(r'<[^()]*>', '', symbol.split('(', 1)[0].split('+', 1)[0])
+  return name.split()[-1] if name.split() else name
+
+def parse_markers():
+  funcs = set()
+  data = set()
+  for name in sorted(os.listdir(REPO)):
+    if not (name.endswith('.h') or name.endswith('.cpp')):
+      continue
+    src = open(os.path.join(REPO, name)).read()
+    funcs.update(re.findall(r'HAL_HOT_FUNC\((\w+)\)\s*(?:<\w+>)?\s*\(', src))
+    data.update(re.findall(r'HAL_HOT_DATA\((\w+)\)\s+\S', src))
+  return funcs, data
+
+def load_functions(objdump, elf):
+  # address -> (symbol, [(insn address, mnemonic, target, target symbol)]), indirect call count
+  out = subprocess.run([objdump, '-d', '-C', '--no-show-raw-insn', elf],
+                       capture_output=True, text=True, check=True).stdout
+  header = re.compile(r'^([0-9a-f]+) <(.+)>:$')
+  branch = re.compile(r'^\s*([0-9a-f]+):\s+(bl|blx|b|b\.[nw]|b[a-z]{2}(?:\.[nw])?)\s+([0-9a-f]+) <(.+)>')
+  indirect = re.compile(r'^\s*[0-9a-f]+:\s+(blx|bx)\s+r\d+')
+  functions = {}
+  current = None
+  for line in out.splitlines():
+    m = header.match(line)
+    if m:
+      current = [m.group(2), [], 0]
+      functions[int(m.group(1), 16)] = current
+      continue
+    if current is None:
+      continue
+    m = branch.match(line)
+    if m:
+      current[1].append((int(m.group(1), 16), m.group(2), int(m.group(3), 16), m.group(4)))
+    elif indirect.match(line):
+      current[2] += 1
+  return functions
+
+def load_data(elf):
+  out = subprocess.run([PREFIX + 'nm', '-C', '--defined-only', elf],
+                       capture_output=True, text=True, check=True).stdout
+  data = {}
+  for line in out.splitlines():
+    v = line.split(None, 2)
+    if len(v) == 3 and v[1] in 'bBdDrR':
+      data[v[2]] = int(v[0], 16)
+  return data
+
+def main():
+  p = argparse.ArgumentParser(description='SRAM hot path check (OREORE_RAM_HOT_PATH)')
+  p.add_argument('elf')
+  p.add_argument('--objdump', default=PREFIX + 'objdump')
+  p.add_argument('--verbose', action='store_true', help='list every function of the hot path')
+  args = p.parse_args()
+
+  hot_funcs, hot_data = parse_markers()
+  functions = load_functions(args.objdump, args.elf)
+  by_name = {}
+  for addr, f in functions.items():
+    by_name.setdefault(base_name(f[0]), []).append(addr)
+  failed = []
+
+  # Marked functions (and their clones) must be in SRAM
+  todo = []
+  for name in sorted(hot_funcs):
+    if name not in by_name:
+      continue  # inlined everywhere
+    for addr in by_name[name]:
+      if in_range(addr, SRAM):
+        todo.append(addr)
+      else:
+        failed.append('%s is in flash (0x%08x)' % (functions[addr][0], addr))
+
+  # Follow direct branches through SRAM
+  seen = set()
+  indirect = 0
+  while todo:
+    addr = todo.pop()
+    if addr in seen:
+      continue
+    seen.add(addr)
+    symbol, branches, n = functions[addr]
+    indirect += n
+    for _, mnemonic, target, target_symbol in branches:
+      if in_range(target, FLASH) or '_veneer' in target_symbol:
+        failed.append('%s -> %s (%s 0x%08x)' % (symbol, target_symbol, mnemonic, target))
+      elif target in functions and in_range(target, SRAM):
+        todo.append(target)
+
+  # Marked data must be in SRAM
+  data = load_data(args.elf)
+  for name in sorted(hot_data):
+    if name in data and not in_range(data[name], SRAM):
+      failed.append('%s is in flash (0x%08x)' % (name, data[name]))
+
+  print('# hot path of %s: %d functions in SRAM, %d indirect calls not followed' %
+        (args.elf, len(seen), indirect))
+  if args.verbose:
+    for addr in sorted(seen):
+      print('0x%08x %s' % (addr, functions[addr][0]))
+  for f in failed:
+    print('error: %s' % f)
+  sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+  main()
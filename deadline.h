@@ -0,0 +1,169 @@
+// Line deadline monitor with watchdog recovery
+//
+// Enabled by OREORE_WATCHDOG (cmake -DOREORE_WATCHDOG=ON, default).
+// - Counts lines whose fetch + pack overran the deadline, and DMA transfers which were still
+//   running when the next line was triggered.
+// - Feeds the hardware watchdog only when a line completes (or the loop polls in WAIT / HALT).
+//   A hung DMA or main loop resets the board after WATCHDOG_TIMEOUT_ms.
+// - Keeps a postmortem record in watchdog scratch registers 0-3, which survive the watchdog reset.
+//   (scratch 4-7 are used by the SDK / bootrom)
+//
+// Postmortem record
+//   scratch[0] [31:16] magic, [15:14] state, [13:10] image, [9:5] overruns, [4:0] dma stalls (saturated)
+//   scratch[1] row index of the last line
+//   scratch[2] [15:0] last line, [31:16] 1 line before
+//   scratch[3] [15:0] 2 lines before, [31:16] 3 lines before
+//   line: fetch + pack time in us (saturated to 0x7fff), bit 15 = deadline missed
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum pm_state {
+    PM_STATE_RUN = 0,
+    PM_STATE_WAIT,
+    PM_STATE_HALT,
+    PM_STATE_BOOT
+};
+
+struct postmortem {
+    uint32_t valid;
+    pm_state state;
+    uint32_t image;
+    uint32_t overruns;
+    uint32_t dma_stalls;
+    int32_t idx;
+    uint16_t lines[4]; // last line first
+};
+
+#if OREORE_WATCHDOG
+
+#include "hardware/watchdog.h"
+
+const uint32_t WATCHDOG_TIMEOUT_ms = 100;
+const uint32_t WATCHDOG_REPORT_TIMEOUT_ms = 5000;  // while reports are printed over USB
+const uint32_t PM_MAGIC = 0xdead;
+
+struct deadline_monitor {
+    uint32_t overruns = 0;      // total
+    uint32_t dma_stalls = 0;    // total
+    uint32_t history = 0;       // 2 lines before (scratch[3] is shifted from scratch[2])
+    uint32_t recent = 0;
+    int32_t line_idx = 0;
+    uint32_t load_us = WATCHDOG_TIMEOUT_ms * 1000;  // LOAD value of the current timeout (1 tick = 1us)
+    postmortem last = {};       // record restored at boot
+
+    void init(){
+        if(watchdog_enable_caused_reboot() && (watchdog_hw->scratch[0] >> 16) == PM_MAGIC){
+            const uint32_t s0 = watchdog_hw->scratch[0];
+            last.valid = 1;
+            last.state = static_cast<pm_state>((s0 >> 14) & 0x3);
+            last.image = (s0 >> 10) & 0xf;
+            last.overruns = (s0 >> 5) & 0x1f;
+            last.dma_stalls = s0 & 0x1f;
+            last.idx = static_cast<int32_t>(watchdog_hw->scratch[1]);
+            last.lines[0] = watchdog_hw->scratch[2] & 0xffff;
+            last.lines[1] = watchdog_hw->scratch[2] >> 16;
+            last.lines[2] = watchdog_hw->scratch[3] & 0xffff;
+            last.lines[3] = watchdog_hw->scratch[3] >> 16;
+        }
+        save(PM_STATE_BOOT, 0, 0);
+        watchdog_enable(WATCHDOG_TIMEOUT_ms, true);
+    }
+
+    void save(const pm_state state, const uint32_t image, const int32_t idx){
+        const uint32_t o = overruns < 0x1f ? overruns : 0x1f;
+        const uint32_t d = dma_stalls < 0x1f ? dma_stalls : 0x1f;
+        watchdog_hw->scratch[0] = (PM_MAGIC << 16) | (state << 14) | ((image & 0xf) << 10) | (o << 5) | d;
+        watchdog_hw->scratch[1] = static_cast<uint32_t>(idx);
+        watchdog_hw->scratch[2] = recent;
+        watchdog_hw->scratch[3] = history;
+    }
+
+    // Called when fetch + pack of a RUN line finished
+    void packed(const int32_t idx, const uint32_t work_us, const bool late){
+        if(late){
+            overruns++;
+        }
+        uint32_t v = work_us < 0x7fff ? work_us : 0x7fff;
+        if(late){
+            v |= 0x8000;
+        }
+        history = (history << 16) | (recent >> 16);
+        recent = (recent << 16) | v;
+        line_idx = idx;
+    }
+
+    // Called just before the DMA trigger of a RUN line
+    void line(const uint32_t image, const bool dma_busy){
+        if(dma_busy){
+            dma_stalls++;
+        }
+        save(PM_STATE_RUN, image, line_idx);
+
+        // Feed only if the previous line has completed
+        // (OREORE_RAM_HOT_PATH: watchdog_update() runs from flash, the LOAD register is written directly)
+        if(!dma_busy){
+#if OREORE_RAM_HOT_PATH
+            watchdog_hw->load = load_us;
+#else
+            watchdog_update();
+#endif
+        }
+    }
+
+    // WAIT / HALT polling
+    void poll(const pm_state state, const uint32_t image, const int32_t idx){
+        save(state, image, idx);
+        watchdog_update();
+    }
+
+    // Reports over USB can take a while
+    void report_begin(){
+        load_us = WATCHDOG_REPORT_TIMEOUT_ms * 1000;
+        watchdog_enable(WATCHDOG_REPORT_TIMEOUT_ms, true);
+    }
+    void report_end(){
+        load_us = WATCHDOG_TIMEOUT_ms * 1000;
+        watchdog_enable(WATCHDOG_TIMEOUT_ms, true);
+    }
+};
+
+deadline_monitor deadline;
+
+void deadline_dump(const char * const * image_names, const uint32_t num_images){
+    printf("# deadline overruns=%lu dma_stalls=%lu\n", (unsigned long)deadline.overruns, (unsigned long)deadline.dma_stalls);
+    const auto & pm = deadline.last;
+    if(!pm.valid){
+        return;
+    }
+    static const char * state_names[] = {"RUN", "WAIT", "HALT", "BOOT"};
+    printf("# postmortem (watchdog reset) state=%s image=%s idx=%ld overruns=%lu dma_stalls=%lu lines=",
+        state_names[pm.state], pm.image < num_images ? image_names[pm.image] : "?", (long)pm.idx,
+        (unsigned long)pm.overruns, (unsigned long)pm.dma_stalls);
+    for(auto l : pm.lines){
+        printf("%u%s ", l & 0x7fff, (l & 0x8000) ? "(late)" : "");
+    }
+    printf("\n");
+}
+
+#define DEADLINE_INIT() deadline.init()
+#define DEADLINE_PACKED(idx, work_us, late) deadline.packed((idx), (work_us), (late))
+#define DEADLINE_LINE(image, dma_busy) deadline.line((image), (dma_busy))
+#define DEADLINE_POLL(state, image, idx) deadline.poll((state), (image), (idx))
+#define DEADLINE_REPORT_BEGIN() deadline.report_begin()
+#define DEADLINE_REPORT_END() deadline.report_end()
+#define DEADLINE_DUMP(names, num) deadline_dump((names), (num))
+
+#else
+
+#define DEADLINE_INIT() ((void)0)
+#define DEADLINE_PACKED(idx, work_us, late) ((void)0)
+#define DEADLINE_LINE(image, dma_busy) ((void)0)
+#define DEADLINE_POLL(state, image, idx) ((void)0)
+#define DEADLINE_REPORT_BEGIN() ((void)0)
+#define DEADLINE_REPORT_END() ((void)0)
+#define DEADLINE_DUMP(names, num) ((void)0)
+
+#endif
@@ -0,0 +1,90 @@
+// Hardware abstraction layer
+//
+// oreore_poi accesses hardware (GPIO, PIO, DMA, timer) through following functions only.
+//   - hal_rp2350.h:     RP2350 implementation (pico SDK, inlined)
+//   - sim/hal_host.cpp: Linux implementation with a virtual clock (OREORE_SIM)
+//
+// GPIO
+//   hal_gpio_init_input(pin)           input with pull up
+//   hal_gpio_init_output(pin)          output, initial value 0
+//   hal_gpio_set_irq_falling(pin, cbk) cbk is called on falling edge
+//   hal_gpio_get_all() / hal_gpio_get(pin) / hal_gpio_put(pin, value)
+// PIO FIFO + DMA
+//   hal_pio_init(pin_base, pin_count, freq)  loads ws2812_parallel
+//   hal_pio_init_clocked(pin_base, pin_count, clock_pin, freq)
+//                                            loads apa102_parallel (data lanes + shared clock at freq)
+//   hal_dma_init(words)                      DMA channel to the PIO TX FIFO, `words` per transfer
+//   hal_dma_start(packet)                    start transfer of `packet`
+//   hal_dma_busy()                           transfer is in progress
+//   hal_dma_set_irq(handler)                 handler is called when a transfer completes
+// Timer
+//   hal_time_us32() / hal_sleep_us(us)
+// Misc
+//   hal_stdio_connected()              USB CDC host is connected (printf reaches somebody)
+//   hal_xip_cache_invalidate()         invalidate whole XIP cache (benchmark of cold flash access)
+//   hal_panic(fmt, ...)                fatal error, does not return
+// Line stages (cost model and trace of the simulator, nothing on RP2350)
+//   hal_stage_mark(HAL_STAGE_BEGIN)    RUN line starts (before extractline)
+//   hal_stage_mark(HAL_STAGE_FETCHED)  source rows are fetched
+//   hal_stage_mark(HAL_STAGE_PACKED)   packet is packed
+// USB CDC (raw, never blocks)
+//   hal_cdc_write_available()          bytes which can be written now (0 if no host is connected)
+//   hal_cdc_write(buf, n)              writes up to n bytes, returns written bytes
+//   hal_cdc_flush()
+// Placement (OREORE_RAM_HOT_PATH: SRAM on RP2350, nothing elsewhere)
+//   HAL_HOT_FUNC(name)                 function definition: void HAL_HOT_FUNC(name)(args){...}
+//   HAL_HOT_DATA(name)                 variable attribute: HAL_HOT_DATA(name) const T name[] = {...}
+
+#pragma once
+
+#include <stdint.h>
+
+enum hal_line_stage {
+    HAL_STAGE_BEGIN = 0,
+    HAL_STAGE_FETCHED,
+    HAL_STAGE_PACKED
+};
+
+#if OREORE_SIM
+
+typedef unsigned int uint;
+typedef void (*hal_gpio_cbk)(uint gpio, uint32_t event_mask);
+typedef void (*hal_irq_handler)();
+
+#define HAL_HOT_FUNC(name) name
+#define HAL_HOT_DATA(name)
+
+void hal_stdio_init();
+
+void hal_gpio_init_input(uint pin);
+void hal_gpio_init_output(uint pin);
+void hal_gpio_set_irq_falling(uint pin, hal_gpio_cbk cbk);
+uint32_t hal_gpio_get_all();
+bool hal_gpio_get(uint pin);
+void hal_gpio_put(uint pin, bool value);
+
+void hal_pio_init(uint pin_base, uint pin_count, float freq);
+void hal_pio_init_clocked(uint pin_base, uint pin_count, uint clock_pin, float freq);
+void hal_dma_init(uint32_t words);
+void hal_dma_start(const uint32_t * packet);
+bool hal_dma_busy();
+void hal_dma_set_irq(hal_irq_handler handler);
+
+uint32_t hal_time_us32();
+void hal_sleep_us(uint64_t us);
+
+bool hal_stdio_connected();
+void hal_xip_cache_invalidate();
+[[noreturn]] void hal_panic(const char * fmt, ...);
+
+void hal_stage_mark(hal_line_stage stage);
+
+uint32_t hal_cdc_write_available();
+uint32_t hal_cdc_write(const void * buf, uint32_t n);
+void hal_cdc_flush();
+
+#else
+
+#include "hal_rp2350.h"
+
+#endif
@@ -0,0 +1,176 @@
+// RP2350 implementation of hal.h (pico SDK)
+
+#pragma once
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/xip_cache.h"
+#include "ws2812.pio.h"
+#if LIB_PICO_STDIO_USB
+#include "pico/stdio_usb.h"
+#include "tusb.h"
+#endif
+
+#define DMA0 0
+
+typedef gpio_irq_callback_t hal_gpio_cbk;
+typedef void (*hal_irq_handler)();
+
+// OREORE_RAM_HOT_PATH: the RUN path runs from SRAM (.time_critical is copied at boot),
+// so its timing does not depend on the XIP cache. Checked after link by check_hot_path.py.
+#if OREORE_RAM_HOT_PATH
+#define HAL_HOT_FUNC(name) __time_critical_func(name)
+#define HAL_HOT_DATA(name) __not_in_flash(#name)
+#else
+#define HAL_HOT_FUNC(name) name
+#define HAL_HOT_DATA(name)
+#endif
+
+static inline void hal_stdio_init(){
+    stdio_init_all();
+}
+
+//-----------------------------------------
+// GPIO
+
+static inline void hal_gpio_init_input(uint pin){
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_pull_up(pin);
+}
+
+static inline void hal_gpio_init_output(uint pin){
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_OUT);
+    gpio_put(pin, 0);
+}
+
+static inline void hal_gpio_set_irq_falling(uint pin, hal_gpio_cbk cbk){
+    gpio_set_irq_enabled_with_callback(pin, GPIO_IRQ_EDGE_FALL, true, cbk);
+}
+
+static inline uint32_t hal_gpio_get_all(){
+    return gpio_get_all();
+}
+
+static inline bool hal_gpio_get(uint pin){
+    return gpio_get(pin);
+}
+
+static inline void hal_gpio_put(uint pin, bool value){
+    gpio_put(pin, value);
+}
+
+//-----------------------------------------
+// PIO FIFO + DMA
+
+static uint hal_pio_sm = 0;
+static hal_irq_handler hal_dma_handler = nullptr;
+
+static inline void hal_pio_init(uint pin_base, uint pin_count, float freq){
+    auto offset0 = pio_add_program(pio0, &ws2812_parallel_program);
+    hal_pio_sm = pio_claim_unused_sm(pio0, true);
+    ws2812_parallel_program_init(pio0, hal_pio_sm, offset0, pin_base, pin_count, freq);
+}
+
+static inline void hal_pio_init_clocked(uint pin_base, uint pin_count, uint clock_pin, float freq){
+    auto offset0 = pio_add_program(pio0, &apa102_parallel_program);
+    hal_pio_sm = pio_claim_unused_sm(pio0, true);
+    apa102_parallel_program_init(pio0, hal_pio_sm, offset0, pin_base, pin_count, clock_pin, freq);
+}
+
+static inline void hal_dma_init(uint32_t words){
+    dma_channel_config dma0_conf = dma_channel_get_default_config(DMA0);
+    channel_config_set_dreq(&dma0_conf, pio_get_dreq(pio0, hal_pio_sm, true)); /* configure data request. true: sending data to the PIO state machine */
+    channel_config_set_transfer_data_size(&dma0_conf, DMA_SIZE_32); /* data transfer size is 32 bits */
+    channel_config_set_read_increment(&dma0_conf, true); /* each read of the data will increase the read pointer */
+    dma_channel_configure(DMA0, &dma0_conf, &pio0->txf[hal_pio_sm], NULL, words, false);
+}
+
+static inline void hal_dma_start(const uint32_t * packet){
+    dma_channel_set_read_addr(DMA0, packet, true);
+}
+
+static inline bool hal_dma_busy(){
+    return dma_channel_is_busy(DMA0);
+}
+
+static void HAL_HOT_FUNC(hal_dma_isr)(){
+    dma_hw->ints0 = 1u << DMA0;
+    hal_dma_handler();
+}
+
+static inline void hal_dma_set_irq(hal_irq_handler handler){
+    hal_dma_handler = handler;
+    dma_channel_set_irq0_enabled(DMA0, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, hal_dma_isr);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+//-----------------------------------------
+// Timer
+
+static inline uint32_t hal_time_us32(){
+    return time_us_32();
+}
+
+static inline void hal_sleep_us(uint64_t us){
+#if OREORE_RAM_HOT_PATH
+    // sleep_us() runs from flash, spin on the timer instead (IRQs are served as usual)
+    const uint32_t t0 = time_us_32();
+    while(time_us_32() - t0 < us){
+        tight_loop_contents();
+    }
+#else
+    sleep_us(us);
+#endif
+}
+
+//-----------------------------------------
+// Misc
+
+static inline bool hal_stdio_connected(){
+#if LIB_PICO_STDIO_USB
+    return stdio_usb_connected();
+#else
+    return false;
+#endif
+}
+
+static inline void hal_xip_cache_invalidate(){
+    xip_cache_invalidate_all();
+}
+
+// panic() of the SDK is variadic, forward the arguments as they are
+#define hal_panic(...) panic(__VA_ARGS__)
+
+static inline void hal_stage_mark(hal_line_stage stage){
+}
+
+//-----------------------------------------
+// USB CDC (raw)
+
+static inline uint32_t hal_cdc_write_available(){
+#if LIB_PICO_STDIO_USB
+    return tud_cdc_connected() ? tud_cdc_write_available() : 0;
+#else
+    return 0;
+#endif
+}
+
+static inline uint32_t hal_cdc_write(const void * buf, uint32_t n){
+#if LIB_PICO_STDIO_USB
+    return tud_cdc_write(buf, n);
+#else
+    return 0;
+#endif
+}
+
+static inline void hal_cdc_flush(){
+#if LIB_PICO_STDIO_USB
+    tud_cdc_write_flush();
+#endif
+}
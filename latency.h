@@ -0,0 +1,104 @@
+// Input-to-light latency
+//
+// Enabled by OREORE_LATENCY (cmake -DOREORE_LATENCY=ON).
+// Timestamps (hal_time_us32) of each push switch operation:
+//
+//   PRESS    falling edge IRQ (psw_cbk), first edge only (bounces are ignored)
+//   BLANK    first DMA trigger of a blank line in State WAIT
+//   RELEASE  State WAIT detects the release and loads the new image
+//   FIRST    first DMA trigger of a RUN line of the new image
+//
+// Histograms: press_to_blank, release_to_first (system latency), press_to_first (includes the hold).
+// `oreore_sim latency` runs many presses on the simulator.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "telemetry.h"  // tlm_histogram
+
+enum lat_hist {
+    LAT_PRESS_TO_BLANK = 0,
+    LAT_RELEASE_TO_FIRST,
+    LAT_PRESS_TO_FIRST,
+    LAT_NUM_HIST
+};
+
+#if OREORE_LATENCY
+
+struct latency_monitor {
+    enum lat_phase { IDLE = 0, PRESSED, BLANKED, RELEASED };
+
+    volatile lat_phase phase = IDLE;
+    volatile uint32_t t_press = 0;
+    uint32_t t_blank = 0;
+    uint32_t t_release = 0;
+    uint32_t presses = 0;
+    tlm_histogram hist[LAT_NUM_HIST] = {
+        {9},    // 0 - 32ms
+        {9},    // 0 - 32ms
+        {13},   // 0 - 512ms
+    };
+
+    // psw_cbk (IRQ)
+    void press(const uint32_t t){
+        if(phase == IDLE || phase == RELEASED){
+            t_press = t;
+            phase = PRESSED;
+        }
+    }
+
+    void blank(const uint32_t t){
+        if(phase == PRESSED){
+            t_blank = t;
+            hist[LAT_PRESS_TO_BLANK].add(t - t_press);
+            phase = BLANKED;
+        }
+    }
+
+    void release(const uint32_t t){
+        if(phase == PRESSED || phase == BLANKED){
+            t_release = t;
+            phase = RELEASED;
+        }
+    }
+
+    void line(const uint32_t t){
+        if(phase == RELEASED){
+            hist[LAT_RELEASE_TO_FIRST].add(t - t_release);
+            hist[LAT_PRESS_TO_FIRST].add(t - t_press);
+            presses++;
+            phase = IDLE;
+        }
+    }
+};
+
+// inline: also used by sim/latency.cpp
+inline latency_monitor latency;
+
+inline void latency_dump(){
+    static const char * names[LAT_NUM_HIST] = {"press_to_blank", "release_to_first", "press_to_first"};
+    printf("# latency presses=%lu\n", (unsigned long)latency.presses);
+    for(uint32_t h=0;h<LAT_NUM_HIST;h++){
+        const auto & hist = latency.hist[h];
+        printf("# latency %s samples=%lu p50=%lu p99=%lu max=%lu\n", names[h],
+            (unsigned long)hist.samples, (unsigned long)hist.percentile(50),
+            (unsigned long)hist.percentile(99), (unsigned long)hist.max);
+    }
+}
+
+#define LATENCY_PRESS() latency.press(hal_time_us32())
+#define LATENCY_BLANK() latency.blank(hal_time_us32())
+#define LATENCY_RELEASE() latency.release(hal_time_us32())
+#define LATENCY_LINE() latency.line(hal_time_us32())
+#define LATENCY_DUMP() latency_dump()
+
+#else
+
+#define LATENCY_PRESS() ((void)0)
+#define LATENCY_BLANK() ((void)0)
+#define LATENCY_RELEASE() ((void)0)
+#define LATENCY_LINE() ((void)0)
+#define LATENCY_DUMP() ((void)0)
+
+#endif
@@ -10,33 +10,35 @@
 
 #include <array>
 #include <stdio.h>
-#include "pico/stdlib.h"
-#include "hardware/dma.h"
-#include "hardware/pio.h"
-
-#define DMA0 0
-#define LENGTH 80 // the number of LEDs on each strip
-
-const uint64_t DEFAULT_PERIOD_us = 2500; // 400Hz
-const uint64_t POLL_GPIO_us = 10000;
-
-#include "ws2812.pio.h"
+#include <string.h>
+#include "poi.h"
 #include "bluewave.h"
 #include "symbol.h"
 #include "rainbow.h"
 #include "singleline.h"
+#include "telemetry.h"
+#include "profile.h"
+#include "xip_stats.h"
+#include "busprof.h"
+#include "deadline.h"
+#include "selfbench.h"
+#include "sampler.h"
+#include "tap.h"
+#include "latency.h"
+#include "arena.h"
 
 //-----------------------------------------
 // Utilities
 
-void sleep_us_since(const uint64_t us, const uint32_t since){
-    const auto curr = time_us_32();
-    const auto spent = curr - since;
-    if(us < spent){
-        return;
+// Sleeps until `deadline` (hal_time_us32). Returns how late it is already (0: on time).
+uint32_t HAL_HOT_FUNC(sleep_until)(const uint32_t deadline){
+    const auto late = static_cast<int32_t>(hal_time_us32() - deadline);
+    if(late >= 0){
+        return late;
     }
 
-    sleep_us(us - spent);
+    hal_sleep_us(-late);
+    return 0;
 }
 
 //-----------------------------------------
@@ -47,7 +49,7 @@ void sleep_us_since(const uint64_t us, const uint32_t since){
 // D0/GPIO26:  PIO[0]
 // D1/GPIO27:  PIO[1]
 // D2/GPIO28:  PIO[2]
-// D3/GPIO5:   -
+// D3/GPIO5:   - (APA102 / SK9822 clock if OREORE_LED_APA102)
 // D4/GPIO6:   -
 // D5/GPIO7:   PushSW
 // D6/GPIO0:   DIP[0]
@@ -57,7 +59,8 @@ void sleep_us_since(const uint64_t us, const uint32_t since){
 // D10/GPIO3:  DIP[4]
 
 const uint PSW_PIN = 7;
-const uint WS2812_SIGNAL0_PIN = 26;
+const uint WS2812_SIGNAL0_PIN = 26;  // data of every LED protocol
+const uint APA102_CLOCK_PIN = 5;
 
 volatile bool psw_pressed = false;
 
@@ -67,7 +70,7 @@ int get_dip_value(){
     const uint32_t dip2_mask = 0x00000004;
     const uint32_t dip3_mask = 0x00000010;
     const uint32_t dip4_mask = 0x00000008;
-    auto raw = gpio_get_all();
+    auto raw = hal_gpio_get_all();
 
     int val = 0;
     if(raw & dip0_mask){val += 1;}
@@ -79,37 +82,44 @@ int get_dip_value(){
     return val;
 }
 
-void psw_cbk(uint gpio, uint32_t event_mask){
+void HAL_HOT_FUNC(psw_cbk)(uint gpio, uint32_t event_mask){
     psw_pressed = true;
+    TELEMETRY_EVENT(TLM_EV_GPIO_IRQ);
+    LATENCY_PRESS();
 }
 
 void sw_pins_init(){
     const uint pins[] = {0, 1, 2, 3, 4, PSW_PIN};
     for(auto pin : pins){
-        gpio_init(pin);
-        gpio_set_dir(pin, GPIO_IN);
-        gpio_pull_up(pin);
+        hal_gpio_init_input(pin);
     }
-    gpio_set_irq_enabled_with_callback(PSW_PIN, GPIO_IRQ_EDGE_FALL, true, psw_cbk);
+    hal_gpio_set_irq_falling(PSW_PIN, psw_cbk);
 }
 
 // User LED (for debug)
 const uint USR_LED_PIN = 25;
 void usr_led_init(){
-    gpio_init(USR_LED_PIN);
-    gpio_set_dir(USR_LED_PIN, GPIO_OUT);
-    gpio_put(USR_LED_PIN, 0);
+    hal_gpio_init_output(USR_LED_PIN);
 }
 
 void pio_init(){
-    auto offset0 = pio_add_program(pio0, &ws2812_parallel_program);
-    auto sm0 = pio_claim_unused_sm(pio0, true);
-    ws2812_parallel_program_init(pio0, sm0, offset0, WS2812_SIGNAL0_PIN, 4, 800000);
-    dma_channel_config dma0_conf = dma_channel_get_default_config(DMA0);
-    channel_config_set_dreq(&dma0_conf, pio_get_dreq(pio0, sm0, true)); /* configure data request. true: sending data to the PIO state machine */
-    channel_config_set_transfer_data_size(&dma0_conf, DMA_SIZE_32); /* data transfer size is 32 bits */
-    channel_config_set_read_increment(&dma0_conf, true); /* each read of the data will increase the read pointer */
-    dma_channel_configure(DMA0, &dma0_conf, &pio0->txf[sm0], NULL, 3*LENGTH, false);
+#if OREORE_LED_APA102
+    hal_pio_init_clocked(WS2812_SIGNAL0_PIN, 4, APA102_CLOCK_PIN, led_strip::BIT_HZ);
+#else
+    hal_pio_init(WS2812_SIGNAL0_PIN, 4, led_strip::BIT_HZ);
+#endif
+    hal_dma_init(PACKET_WORDS);
+}
+
+// DMA completion IRQ (used by instrumentation only)
+void HAL_HOT_FUNC(dma_irq_handler)(){
+    TELEMETRY_DMA_DONE();
+}
+
+void dma_irq_init(){
+#if OREORE_TELEMETRY
+    hal_dma_set_irq(dma_irq_handler);
+#endif
 }
 
 //-----------------------------------------
@@ -129,48 +139,44 @@ void pio_init(){
 // [STRIP3-R0][STRIP2-R0][STRIP1-R0][STRIP0-R0][STRIP3-R1][STRIP2-R1][STRIP1-R1][STRIP0-R1] ... [STRIP3-R7][STRIP2-R7][STRIP1-R7][STRIP0-R7]
 // [STRIP3-B0][STRIP2-B0][STRIP1-B0][STRIP0-B0][STRIP3-B1][STRIP2-B1][STRIP1-B1][STRIP0-B1] ... [STRIP3-B7][STRIP2-B7][STRIP1-B7][STRIP0-B7]
 // // [STRIPx-Gy|Ry|By] = 1bit
-
-struct image_info {
-    // static information
-    // image size should be width * height * 3(RGB) bytes.
-    const uint8_t * image;
-    uint32_t width;     // 240
-    uint32_t height;
-    uint64_t period_us;
-    bool loop;          // Output image repeatedly if true
-    bool mirror;        // Output ABCCBA if true (image = ABC)
-    bool multiline;     // Use multiline poi
-
-    image_info(
-        const uint8_t * image_,
-        uint32_t width_,
-        uint32_t height_,
-        uint64_t period_us_ = DEFAULT_PERIOD_us,
-        bool loop_ = true,
-        bool mirror_ = false,
-        bool multiline_ = true
-    ) : image(image_), width(width_), height(height_), period_us(period_us_), loop(loop_), mirror(mirror_), multiline(multiline_) {
-    }
-
-};
-
+//
+// 3. SK6812 RGBW (OREORE_LED_RGBW)
+// Images stay RGB. A fourth word [STRIPx-Wy] follows B, W is extracted from RGB at pack time (white_lut)
 
 #define IMG(x) (&(x[0][0]))
 #define WID(x) (sizeof(x[0])/sizeof(x[0][0])/3)
 #define HEI(x) (sizeof(x)/sizeof(x[0]))
 
-image_info info_bluewave(IMG(bluewave), WID(bluewave), HEI(bluewave), DEFAULT_PERIOD_us * 3, false, false, false);
+image_info info_bluewave(IMG(bluewave), WID(bluewave), HEI(bluewave), DEFAULT_PERIOD_us * 3, false, false, false, OVERLOAD_SKIP);
 image_info info_rainbow(IMG(rainbow), WID(rainbow), HEI(rainbow));
-image_info info_symbol(IMG(symbol), WID(symbol), HEI(symbol));
+image_info info_symbol(IMG(symbol), WID(symbol), HEI(symbol), DEFAULT_PERIOD_us, true, false, true, OVERLOAD_CHEAP);
 image_info info_red(IMG(red), WID(red), HEI(red));
 image_info info_green(IMG(green), WID(green), HEI(green));
 image_info info_blue(IMG(blue), WID(blue), HEI(blue));
 
+// Image list for reports (telemetry etc.)
+HAL_HOT_DATA(image_table) image_info * const image_table[] = {
+    &info_bluewave, &info_rainbow, &info_symbol, &info_red, &info_green, &info_blue
+};
+const char * const image_names[] = {
+    "bluewave", "rainbow", "symbol", "red", "green", "blue"
+};
+const uint32_t num_images = sizeof(image_table)/sizeof(image_table[0]);
+
+uint32_t HAL_HOT_FUNC(image_id)(const image_info * info){
+    for(uint32_t i=0;i<num_images;i++){
+        if(image_table[i] == info){
+            return i;
+        }
+    }
+    return 0;
+}
+
 //-----------------------------------------
 // Data Handling
 
 // 8bit R/G/B data format is converted to ws2812_parallel PIO format through parallel_lut and interleave function.
-constexpr uint32_t parallel_lut[256] = {
+HAL_HOT_DATA(parallel_lut) constexpr uint32_t parallel_lut[256] = {
     0x00000000, 0x10000000, 0x01000000, 0x11000000, 0x00100000, 0x10100000, 0x01100000, 0x11100000,
     0x00010000, 0x10010000, 0x01010000, 0x11010000, 0x00110000, 0x10110000, 0x01110000, 0x11110000,
     0x00001000, 0x10001000, 0x01001000, 0x11001000, 0x00101000, 0x10101000, 0x01101000, 0x11101000,
@@ -205,15 +211,86 @@ constexpr uint32_t parallel_lut[256] = {
     0x00011111, 0x10011111, 0x01011111, 0x11011111, 0x00111111, 0x10111111, 0x01111111, 0x11111111
 };
 
-uint32_t interleave(const uint8_t v0, const uint8_t v1, const uint8_t v2, const uint8_t v3 = 0){
+uint32_t HAL_HOT_FUNC(interleave)(const uint8_t v0, const uint8_t v1, const uint8_t v2, const uint8_t v3){
     return parallel_lut[v0] | (parallel_lut[v1] << 1) | (parallel_lut[v2] << 2) | (parallel_lut[v3] << 3);
 }
 
-void pack_parallel(uint32_t (&packet)[3*LENGTH], const uint8_t * line){
+// White extraction (RGBW strips, led_sk6812)
+// The gray part min(R, G, B) of a pixel moves to the W channel: R, G, B lose it and W gets
+// min * WHITE_GAIN / 256. white_lut holds that W value already packed as lane 0 (as parallel_lut),
+// so the W word costs the same three loads as a color word.
+struct white_table {
+    uint32_t v[256];
+    constexpr white_table() : v(){
+        for(uint32_t m=0;m<256;m++){
+            const uint32_t w = m * led_sk6812::WHITE_GAIN / 256;
+            v[m] = parallel_lut[w < 255 ? w : 255];
+        }
+    }
+};
+HAL_HOT_DATA(white_lut) constexpr white_table white_lut;
+
+// Packers
+//
+// Written once as templates on the protocol (kernels::), and defined for every protocol by explicit
+// specializations of the templates of poi.h at the end. Only those keep HAL_HOT_FUNC placement:
+// GCC puts template instantiations into their own .text sections whatever their attributes say,
+// so the kernels are always inlined into the specializations.
+namespace kernels {
+
+// Color words of LED i (see led_ws2812 / led_apa102 / led_sk6812)
+template<class LED>
+[[gnu::always_inline]] static inline uint32_t * led_words(uint32_t * packet, const int i){
+    return packet + LED::HEAD_WORDS + i * LED::WORDS_PER_LED;
+}
+template<class LED>
+[[gnu::always_inline]] static inline const uint32_t * led_words(const uint32_t * packet, const int i){
+    return packet + LED::HEAD_WORDS + i * LED::WORDS_PER_LED;
+}
+
+[[gnu::always_inline]] static inline uint8_t min3(const uint8_t * p){
+    const uint8_t m = p[0] < p[1] ? p[0] : p[1];
+    return m < p[2] ? m : p[2];
+}
+
+// Color words of one LED, p0 / p1 / p2: R, G, B bytes of lane 0 / 1 / 2
+// RGB protocols compile to the three color words only, the white extraction is there for WHITE ones.
+template<class LED>
+[[gnu::always_inline]] static inline void pack_led(uint32_t * w, const uint8_t * p0, const uint8_t * p1, const uint8_t * p2){
+    const uint32_t * const lut = parallel_lut;
+    if constexpr (LED::WHITE){
+        const uint8_t m0 = min3(p0), m1 = min3(p1), m2 = min3(p2);
+        w[LED::G] = lut[p0[1] - m0] | (lut[p1[1] - m1] << 1) | (lut[p2[1] - m2] << 2);
+        w[LED::R] = lut[p0[0] - m0] | (lut[p1[0] - m1] << 1) | (lut[p2[0] - m2] << 2);
+        w[LED::B] = lut[p0[2] - m0] | (lut[p1[2] - m1] << 1) | (lut[p2[2] - m2] << 2);
+        w[LED::W] = white_lut.v[m0] | (white_lut.v[m1] << 1) | (white_lut.v[m2] << 2);
+    }else{
+        w[LED::G] = lut[p0[1]] | (lut[p1[1]] << 1) | (lut[p2[1]] << 2);
+        w[LED::R] = lut[p0[0]] | (lut[p1[0]] << 1) | (lut[p2[0]] << 2);
+        w[LED::B] = lut[p0[2]] | (lut[p1[2]] << 1) | (lut[p2[2]] << 2);
+    }
+}
+
+template<class LED>
+[[gnu::always_inline]] static inline void pack_frame(uint32_t (&packet)[packet_words<LED>()]){
+    for(uint32_t i=0;i<LED::HEAD_WORDS;i++){
+        packet[i] = 0;
+    }
+    if(LED::LED_HEADER){
+        const auto h = LED::LED_HEADER_BYTE;
+        for(int i=0;i<LENGTH;i++){
+            led_words<LED>(packet, i)[0] = interleave(h, h, h, h);
+        }
+    }
+    for(uint32_t i=0;i<LED::TAIL_WORDS;i++){
+        packet[packet_words<LED>() - 1 - i] = 0;
+    }
+}
+
+template<class LED>
+[[gnu::always_inline]] static inline void pack_parallel(uint32_t (&packet)[packet_words<LED>()], const uint8_t * line){
     for(int i=0;i<LENGTH;i++){
-        packet[i*3]   = interleave(line[i*9+1], line[i*9+4], line[i*9+7]); // G
-        packet[i*3+1] = interleave(line[i*9],   line[i*9+3], line[i*9+6]); // R
-        packet[i*3+2] = interleave(line[i*9+2], line[i*9+5], line[i*9+8]); // B
+        pack_led<LED>(led_words<LED>(packet, i), &line[i*9], &line[i*9+3], &line[i*9+6]);
     }
 }
 
@@ -231,32 +308,208 @@ void pack_parallel(uint32_t (&packet)[3*LENGTH], const uint8_t * line){
 //   |      [1-0]       [1-1]       [1-2]    ...  [1-79]      <- line1
 //   |  [0-0]       [0-1]       [0-2]   ...  [0-79]           <- line0
 
-void pack_parallel_sft(
-    uint32_t (&packet)[3*LENGTH],
+template<class LED>
+[[gnu::always_inline]] static inline void pack_parallel_sft(
+    uint32_t (&packet)[packet_words<LED>()],
     const uint8_t *line0,
     const uint8_t *line1,
     const uint8_t *line2,
-    bool reverse = false
+    bool reverse
 ){
     if(!reverse){
         for(int i=0;i<LENGTH;i++){
-            packet[i*3]   = interleave(line2[i*9+1], line1[i*9+4], line0[i*9+7]); // G
-            packet[i*3+1] = interleave(line2[i*9],   line1[i*9+3], line0[i*9+6]); // R
-            packet[i*3+2] = interleave(line2[i*9+2], line1[i*9+5], line0[i*9+8]); // B
+            pack_led<LED>(led_words<LED>(packet, i), &line2[i*9], &line1[i*9+3], &line0[i*9+6]);
         }
     }else{
         for(int i=0;i<LENGTH;i++){
-            packet[i*3]   = interleave(line0[i*9+1], line1[i*9+4], line2[i*9+7]); // G
-            packet[i*3+1] = interleave(line0[i*9],   line1[i*9+3], line2[i*9+6]); // R
-            packet[i*3+2] = interleave(line0[i*9+2], line1[i*9+5], line2[i*9+8]); // B
+            pack_led<LED>(led_words<LED>(packet, i), &line0[i*9], &line1[i*9+3], &line2[i*9+6]);
+        }
+    }
+}
+
+// Batched packing
+//
+// Lane l of every LED comes from s[l] (one row for all lanes, or one row per lane as pack_parallel_sft).
+// The LUT base and row pointers stay in registers across LEDs and lines, and offsets are walked instead
+// of recomputed. The per-line work is the same as pack_parallel(_sft): the batch saves the calls only.
+template<class LED>
+[[gnu::always_inline]] static inline void pack_lanes(uint32_t * packet, const uint8_t * s0, const uint8_t * s1, const uint8_t * s2){
+    uint32_t * w = led_words<LED>(packet, 0);
+    for(int i=0;i<LENGTH;i++){
+        pack_led<LED>(w, s0, s1 + 3, s2 + 6);
+        w += LED::WORDS_PER_LED;
+        s0 += 9;
+        s1 += 9;
+        s2 += 9;
+    }
+}
+
+template<class LED>
+[[gnu::always_inline]] static inline void pack_lines(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()]){
+    for(uint32_t k=0;k<count;k++){
+        pack_lanes<LED>(out[k], rows[k], rows[k], rows[k]);
+    }
+}
+
+template<class LED>
+[[gnu::always_inline]] static inline void pack_lines_sft(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()], bool reverse){
+    for(uint32_t k=0;k<count;k++){
+        if(!reverse){
+            pack_lanes<LED>(out[k], rows[k+2], rows[k+1], rows[k]);
+        }else{
+            pack_lanes<LED>(out[k], rows[k], rows[k+1], rows[k+2]);
+        }
+    }
+}
+
+// Packed-domain transforms
+//
+// Nibble n of a packed word holds bit (7 - n) of the value of every lane (lane l = bit l of the nibble),
+// so packed or cached lines can be restyled without going back through interleave():
+//   value >> s (brightness / 2^s)  word << 4*s (LSB planes drop out of the top nibbles)
+//   mute / solo / channel masks    word & (PACKED_LANE0 * lanes), G, R, B (, W) words are masked separately
+// Only color words are written, dst may be src.
+template<class LED>
+[[gnu::always_inline]] static inline void apply_packed_style(uint32_t (&dst)[packet_words<LED>()], const uint32_t (&src)[packet_words<LED>()], const packed_style & style){
+    if(style.shift >= 8){
+        for(int i=0;i<LENGTH;i++){
+            auto d = led_words<LED>(dst, i);
+            d[LED::G] = d[LED::R] = d[LED::B] = 0;
+            if constexpr (LED::WHITE){
+                d[LED::W] = 0;
+            }
+        }
+        return;
+    }
+    const uint32_t sft = style.shift * 4;
+    const uint32_t mg = style.mask[0], mr = style.mask[1], mb = style.mask[2];
+    for(int i=0;i<LENGTH;i++){
+        auto d = led_words<LED>(dst, i);
+        const auto s = led_words<LED>(src, i);
+        d[LED::G] = (s[LED::G] << sft) & mg;
+        d[LED::R] = (s[LED::R] << sft) & mr;
+        d[LED::B] = (s[LED::B] << sft) & mb;
+        if constexpr (LED::WHITE){
+            d[LED::W] = (s[LED::W] << sft) & style.mask[3];
+        }
+    }
+}
+
+// Temporal dithering
+//
+// Every byte is scaled by brightness / 256 and the fraction is carried to the same byte of the next line
+// (error diffusion in time). At 400 lines/s a dim value alternates between the two nearest steps and
+// averages to the exact value within a few lines, so low brightness gradients do not band.
+// Sources are per lane as pack_parallel_dirty. Costs one multiply-add per byte on top of the pack.
+template<class LED>
+[[gnu::always_inline]] static inline void pack_parallel_dither(
+    uint32_t (&packet)[packet_words<LED>()],
+    const uint8_t * const (&src)[3],
+    const uint32_t brightness,
+    uint8_t (&err)[9*LENGTH]
+){
+    for(int i=0;i<LENGTH;i++){
+        const int o = i*9;
+        uint8_t v[9];
+        for(int b=0;b<9;b++){
+            const uint32_t acc = src[b/3][o+b] * brightness + err[o+b];
+            err[o+b] = acc & 0xff;
+            v[b] = acc >> 8;
+        }
+        pack_led<LED>(led_words<LED>(packet, i), &v[0], &v[3], &v[6]);
+    }
+}
+
+// Incremental repacking
+//
+// LED i of lane l comes from src[l][i*9 + 3*l .. +2] (pack_parallel: one row for all lanes,
+// pack_parallel_sft: one row per lane). LEDs whose source triplets equal those of `prev`
+// (same row pointer, or same bytes) are left as they are in the packet.
+// Once DIRTY_FALLBACK_LEDS LEDs have changed (new rows of multiline images) the rest is packed
+// without comparing, so a line which changes everywhere costs a few compares more than a full pack.
+// Returns the number of repacked LEDs (0: the packet is unchanged).
+static inline bool same_triplet(const uint8_t * a, const uint8_t * b){
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+template<class LED>
+[[gnu::always_inline]] static inline uint32_t pack_parallel_dirty(
+    uint32_t (&packet)[packet_words<LED>()],
+    const uint8_t * const (&prev)[3],
+    const uint8_t * const (&src)[3]
+){
+    const bool same0 = src[0] == prev[0];
+    const bool same1 = src[1] == prev[1];
+    const bool same2 = src[2] == prev[2];
+    if(same0 && same1 && same2){
+        return 0;
+    }
+
+    uint32_t repacked = 0;
+    int i = 0;
+    for(;i<LENGTH && repacked<DIRTY_FALLBACK_LEDS;i++){
+        const int o = i*9;
+        if((same0 || same_triplet(&src[0][o],   &prev[0][o])) &&
+           (same1 || same_triplet(&src[1][o+3], &prev[1][o+3])) &&
+           (same2 || same_triplet(&src[2][o+6], &prev[2][o+6]))){
+            continue;
         }
+        pack_led<LED>(led_words<LED>(packet, i), &src[0][o], &src[1][o+3], &src[2][o+6]);
+        repacked++;
+    }
+    for(;i<LENGTH;i++){
+        const int o = i*9;
+        pack_led<LED>(led_words<LED>(packet, i), &src[0][o], &src[1][o+3], &src[2][o+6]);
+        repacked++;
     }
+    return repacked;
 }
 
+}
+
+// The simulator builds the packers of every protocol (verified side by side), the firmware of its own only
+#define DEFINE_PACKERS(LED) \
+    template<> void pack_frame<LED>(uint32_t (&packet)[packet_words<LED>()]){ \
+        kernels::pack_frame<LED>(packet); \
+    } \
+    template<> void HAL_HOT_FUNC(pack_parallel)<LED>(uint32_t (&packet)[packet_words<LED>()], const uint8_t * line){ \
+        kernels::pack_parallel<LED>(packet, line); \
+    } \
+    template<> void HAL_HOT_FUNC(pack_parallel_sft)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * line0, const uint8_t * line1, const uint8_t * line2, bool reverse){ \
+        kernels::pack_parallel_sft<LED>(packet, line0, line1, line2, reverse); \
+    } \
+    template<> void pack_lines<LED>(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()]){ \
+        kernels::pack_lines<LED>(rows, count, out); \
+    } \
+    template<> void pack_lines_sft<LED>(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()], bool reverse){ \
+        kernels::pack_lines_sft<LED>(rows, count, out, reverse); \
+    } \
+    template<> void HAL_HOT_FUNC(apply_packed_style)<LED>(uint32_t (&dst)[packet_words<LED>()], \
+        const uint32_t (&src)[packet_words<LED>()], const packed_style & style){ \
+        kernels::apply_packed_style<LED>(dst, src, style); \
+    } \
+    template<> void HAL_HOT_FUNC(pack_parallel_dither)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * const (&src)[3], const uint32_t brightness, uint8_t (&err)[9*LENGTH]){ \
+        kernels::pack_parallel_dither<LED>(packet, src, brightness, err); \
+    } \
+    template<> uint32_t HAL_HOT_FUNC(pack_parallel_dirty)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * const (&prev)[3], const uint8_t * const (&src)[3]){ \
+        return kernels::pack_parallel_dirty<LED>(packet, prev, src); \
+    }
+
+#if OREORE_SIM
+DEFINE_PACKERS(led_ws2812)
+DEFINE_PACKERS(led_apa102)
+DEFINE_PACKERS(led_sk6812)
+#else
+DEFINE_PACKERS(led_strip)
+#endif
 
-constexpr uint8_t blankline[720] = {};
 
-const uint8_t * extractline(const image_info * info, const int32_t y){
+HAL_HOT_DATA(blankline) const uint8_t blankline[720] = {};
+
+const uint8_t * HAL_HOT_FUNC(extractline)(const image_info * info, const int32_t y){
     if(y < 0){
         return blankline;
     }
@@ -296,75 +549,299 @@ image_info * loadImage(){
         case 12: info = &info_red;        break;
         case 13: info = &info_green;      break;
         case 14: info = &info_blue;       break;
-        case 15: info = &info_blue;       break;
+        case 15: info = &info_blue;       break; // self benchmark if OREORE_SELFBENCH
     }
     return info;
 }
 
 
-int main()
-{
+poi_context poi = {};
+
+// SRAM buffers are allocated once, poi_setup can run again (simulator)
+void poi_buffers_init(){
+    static const auto packets = arena_main.alloc<uint32_t[PACKET_WORDS]>("packet ring", PACKET_BUFFERS);
+    static const auto dither_err = arena_scratch_x.alloc<uint8_t[9*LENGTH]>("dither error");
+    poi.packets = packets;
+    for(uint32_t i=0;i<PACKET_BUFFERS;i++){
+        pack_frame(packets[i]);
+    }
+    poi.dither_err = dither_err;
+    memset(*dither_err, 0, sizeof(*dither_err));
+}
+
+void poi_setup(){
+    hal_stdio_init();
+    poi_buffers_init();
     sw_pins_init();
     usr_led_init();
     pio_init();
+    dma_irq_init();
+    PROFILE_INIT();
+    BUSPROF_INIT();
+    DEADLINE_INIT();
+    SAMPLER_INIT();
 
-    auto info = loadImage();
+    poi.info = loadImage();
     auto dip_state = get_dip_value();
-    bool reverse = (dip_state & 0x00000010) == 0x00000010;
+    poi.reverse = (dip_state & 0x00000010) == 0x00000010;
+    poi.selfbench = SELFBENCH_SELECTED(dip_state);
 
-    gpio_put(USR_LED_PIN, reverse);
+    hal_gpio_put(USR_LED_PIN, poi.reverse);
 
-    // State transition
-    // RUN  --(Draw finished && loop is disabled)-> HALT
-    // RUN  --(Push SW is pressed)-> WAIT
-    // HALT --(Push SW is pressed)-> WAIT
-    // WAIT --(Push Sw is released)-> RUN
-
-    uint32_t pio_packet[3*LENGTH];
-    int32_t idx = 0;
-    while(1){
-        // State WAIT:
-        // Suppress output while push switch is down
-        if(psw_pressed){
-            if(gpio_get(PSW_PIN)){
-                psw_pressed = false;
-                idx = info->multiline ? -2 : 0;
-                info = loadImage();
-                continue;
-            }
+    if(poi.selfbench){
+        DEADLINE_REPORT_BEGIN();
+        SELFBENCH_RUN(image_table, image_names, num_images);
+        DEADLINE_REPORT_END();
+    }
+}
 
-            pack_parallel(pio_packet, blankline);
-            sleep_us(POLL_GPIO_us);
-            dma_channel_set_read_addr(DMA0, (void*)pio_packet, true);
-            continue;
+// State transition
+// RUN  --(Draw finished && loop is disabled)-> HALT
+// RUN  --(Push SW is pressed)-> WAIT
+// HALT --(Push SW is pressed)-> WAIT
+// WAIT --(Push Sw is released)-> RUN
+
+void poi_run_line();
+
+// One iteration of the main loop
+void poi_loop_once(){
+    auto & info = poi.info;
+    auto & idx = poi.idx;
+    auto & pass = poi.pass;
+    auto & reported = poi.reported;
+
+    // Self benchmark (DIP 15): results are reported on release of the push switch
+    if(poi.selfbench){
+        const bool released = psw_pressed && hal_gpio_get(PSW_PIN);
+        if(released){
+            psw_pressed = false;
         }
+        SELFBENCH_POLL(USR_LED_PIN, released);
+        hal_sleep_us(POLL_GPIO_us);
+        DEADLINE_POLL(PM_STATE_WAIT, image_id(info), idx);
+        return;
+    }
 
-        // State HALT:
-        if(idx == INT32_MIN){
-            sleep_us(POLL_GPIO_us);
-            continue;
+    // State WAIT:
+    // Suppress output while push switch is down
+    if(psw_pressed){
+        if(!reported){
+            // Report once per press (LEDs are blank, timing does not matter)
+            DEADLINE_REPORT_BEGIN();
+            TELEMETRY_DUMP(image_names);
+            PROFILE_DUMP();
+            XIP_STATS_DUMP(image_names, num_images);
+            BUSPROF_DUMP();
+            SAMPLER_DUMP();
+            TAP_DUMP();
+            LATENCY_DUMP();
+            arena_dump();
+            DEADLINE_DUMP(image_names, num_images);
+            DEADLINE_REPORT_END();
+            reported = true;
+        }
+        if(hal_gpio_get(PSW_PIN)){
+            LATENCY_RELEASE();
+            psw_pressed = false;
+            reported = false;
+            idx = info->multiline ? -2 : 0;
+            pass = 0;
+            poi.scheduled = false;
+            poi.cheap_lines = 0;
+            info = loadImage();
+            return;
         }
 
-        // State RUN:
-        // Refresh LEDs periodically
-        auto t = time_us_32();
-        if(info->multiline){
-            pack_parallel_sft(pio_packet, extractline(info, idx), extractline(info, idx+1), extractline(info, idx+2), reverse);
+        // The other packet may still be sent by DMA
+        auto & pio_packet = poi.packets[poi.cur ^= 1];
+        pack_parallel(pio_packet, blankline);
+        poi.packed_src[poi.cur][0] = nullptr;
+        poi.sent_src[0] = nullptr;
+        TAP_POLL();
+        BUSPROF_IDLE();
+        hal_sleep_us(POLL_GPIO_us);
+        DEADLINE_POLL(PM_STATE_WAIT, image_id(info), idx);
+        TELEMETRY_IDLE();
+        LATENCY_BLANK();
+        hal_dma_start(pio_packet);
+        return;
+    }
+
+    // State HALT:
+    if(idx == INT32_MIN){
+        TAP_POLL();
+        BUSPROF_IDLE();
+        hal_sleep_us(POLL_GPIO_us);
+        DEADLINE_POLL(PM_STATE_HALT, image_id(info), idx);
+        return;
+    }
+
+    // State RUN:
+    poi_run_line();
+}
+
+// State RUN: one line
+// Everything this calls is in SRAM with OREORE_RAM_HOT_PATH (check_hot_path.py). WAIT / HALT and
+// the reports stay in flash. Instrumentation other than the watchdog is not covered.
+void HAL_HOT_FUNC(poi_run_line)(){
+    auto & info = poi.info;
+    auto & idx = poi.idx;
+    auto & pass = poi.pass;
+    const auto reverse = poi.reverse;
+
+    // Refresh LEDs periodically, on a time grid of period_us
+    auto t = hal_time_us32();
+    if(!poi.scheduled){
+        poi.deadline = t + info->period_us;
+        poi.scheduled = true;
+    }
+    const auto line_deadline = poi.deadline;
+    const bool multiline = info->multiline && poi.cheap_lines == 0;
+    TELEMETRY_BEGIN(idx, image_id(info), t, line_deadline);
+    hal_stage_mark(HAL_STAGE_BEGIN);
+    XIP_STATS_BEGIN();
+    BUSPROF_RESUME();
+    const uint8_t * line0;
+    const uint8_t * line1 = blankline;
+    const uint8_t * line2 = blankline;
+    {
+        PROFILE_SCOPE(PROF_EXTRACT);
+        line0 = extractline(info, idx);
+        if(multiline){
+            line1 = extractline(info, idx+1);
+            line2 = extractline(info, idx+2);
+        }
+    }
+    hal_stage_mark(HAL_STAGE_FETCHED);
+    TELEMETRY_STAMP(TLM_FETCH_END);
+    // The other packet may still be sent by DMA
+    auto & pio_packet = poi.packets[poi.cur ^= 1];
+    auto & packed_src = poi.packed_src[poi.cur];
+    {
+        PROFILE_SCOPE(PROF_PACK);
+        const uint8_t * src[3] = {line0, line0, line0};
+        if(multiline){
+            src[0] = reverse ? line0 : line2;
+            src[1] = line1;
+            src[2] = reverse ? line2 : line0;
+        }
+        const bool dither = poi.brightness < 256;
+        // Multiline rows move every line, they are compared only if a lane kept its row (blank lines)
+        const bool kept_row = packed_src[0] == src[0] || packed_src[1] == src[1] || packed_src[2] == src[2];
+        if(dither){
+            pack_parallel_dither(pio_packet, src, poi.brightness, *poi.dither_err);
+        }else if(packed_src[0] && poi.style.identity() && (!multiline || kept_row)){
+            // Height-1 images and slowly changing rows repack a few LEDs or none
+            pack_parallel_dirty(pio_packet, packed_src, src);
+        }else if(multiline){
+            pack_parallel_sft(pio_packet, line0, line1, line2, reverse);
         }else{
-            pack_parallel(pio_packet, extractline(info, idx));
+            pack_parallel(pio_packet, line0);
         }
-
+        if(poi.style.identity() && !dither){
+            for(int l=0;l<3;l++){
+                packed_src[l] = src[l];
+            }
+        }else{
+            if(!poi.style.identity()){
+                apply_packed_style(pio_packet, pio_packet, poi.style);
+            }
+            packed_src[0] = nullptr;
+        }
+    }
+    hal_stage_mark(HAL_STAGE_PACKED);
+    TELEMETRY_STAMP(TLM_PACK_END);
+    XIP_STATS_END(image_id(info), get_xip_phase(pass, info->mirror && idx >= static_cast<int32_t>(info->height)));
+    if(multiline != info->multiline){
+        poi.cheap_lines--;
+        TELEMETRY_OVERLOAD(TLM_EV_CHEAP, 1);
+    }
+    BUSPROF_LINE(hal_time_us32() - t, static_cast<int32_t>(line_deadline - hal_time_us32()));
+    DEADLINE_PACKED(idx, hal_time_us32() - t, static_cast<int32_t>(hal_time_us32() - line_deadline) > 0);
+    TAP_LINE(pio_packet, idx, image_id(info));
+    TAP_POLL();
+
+    uint32_t late;
+    {
+        PROFILE_SCOPE(PROF_SLEEP);
+        late = sleep_until(line_deadline);
+    }
+    bool drop = false;
+    {
+        PROFILE_SCOPE(PROF_SCHEDULE);
         const int32_t limit = info->mirror ? info->height * 2 : info->height;
-        if(++idx >= limit){
-            // Switch to State HALT here
-            idx = info->loop ? 0 : INT32_MIN;
+        auto next_row = [&](){
+            if(idx != INT32_MIN && ++idx >= limit){
+                // Switch to State HALT here
+                idx = info->loop ? 0 : INT32_MIN;
+                pass++;
+            }
+        };
+        next_row();
+
+        const uint32_t period = info->period_us;
+        poi.deadline = line_deadline + period;
+        if(late > 0 && info->overload == OVERLOAD_SLIP){
+            poi.deadline = line_deadline + late + period;
+        }else if(late > 0){
+            // Next grid slot which is a full period after this trigger (REPEAT does not trigger)
+            drop = info->overload == OVERLOAD_REPEAT;
+            const uint32_t slots = (late + period - 1) / period + (drop ? 0 : 1);
+            for(uint32_t n=1;n<slots;n++){
+                next_row();
+            }
+            poi.deadline = line_deadline + slots * period;
+            if(drop){
+                TELEMETRY_OVERLOAD(TLM_EV_REPEAT, 1);
+            }
+            if(slots > 1){
+                TELEMETRY_OVERLOAD(TLM_EV_SKIP, slots - 1);
+            }
+            if(info->overload == OVERLOAD_CHEAP && info->multiline){
+                poi.cheap_lines = OVERLOAD_CHEAP_LINES;
+            }
         }
-        sleep_us_since(info->period_us, t);
+    }
 
-        // This code calls pack, sleep and dma functions sequentially.
-        // Flash memory caching should happen while sleep.
-        // // LEDs could flicker if caching and dma transfer run simultaneously.
-        dma_channel_set_read_addr(DMA0, (void*)pio_packet, true);
+    if(drop){
+        // LEDs keep the previous line
+        DEADLINE_LINE(image_id(info), hal_dma_busy());
+        return;
     }
 
+    // This code calls pack, sleep and dma functions sequentially.
+    // Flash memory caching should happen while sleep.
+    // // LEDs could flicker if caching and dma transfer run simultaneously.
+#if OREORE_DMA_SKIP
+    // WS2812 keeps the latched values, so a line from the same rows is not resent.
+    // It is refreshed every DMA_REFRESH_LINES to recover from glitches.
+    const bool unchanged = packed_src[0] &&
+        packed_src[0] == poi.sent_src[0] && packed_src[1] == poi.sent_src[1] && packed_src[2] == poi.sent_src[2];
+    if(unchanged && poi.dma_skipped < DMA_REFRESH_LINES){
+        poi.dma_skipped++;
+        DEADLINE_LINE(image_id(info), hal_dma_busy());
+        return;     // the telemetry record is overwritten by the next line
+    }
+    poi.dma_skipped = 0;
+#endif
+    TELEMETRY_DMA_START();
+    DEADLINE_LINE(image_id(info), hal_dma_busy());
+    LATENCY_LINE();
+    {
+        PROFILE_SCOPE(PROF_DMA_ARM);
+        hal_dma_start(pio_packet);
+    }
+    for(int l=0;l<3;l++){
+        poi.sent_src[l] = packed_src[l];
+    }
+}
+
+#if !OREORE_SIM
+int main()
+{
+    poi_setup();
+    while(1){
+        poi_loop_once();
+    }
 }
+#endif
@@ -0,0 +1,237 @@
+// Declarations shared by the firmware (oreore_poi.cpp) and the host simulator (sim/)
+
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+
+#define LENGTH 80 // the number of LEDs on each strip
+
+// LED protocols
+//
+// Packets of every protocol use the ws2812_parallel word format: nibble n of a word holds serial bit (7 - n)
+// of every lane (lane l = bit l of the nibble), so one word carries one byte of each lane.
+// A protocol is a layout of such words. The packers are templates on it, led_strip is the one of the build.
+struct led_ws2812 {     // WS2812B (ws2812_parallel): latched by the reset time between lines
+    static const uint32_t BIT_HZ = 800000;
+    static const uint32_t HEAD_WORDS = 0;       // before the first LED
+    static const uint32_t WORDS_PER_LED = 3;
+    static const uint32_t G = 0, R = 1, B = 2;  // word of each channel in the LED
+    static const bool LED_HEADER = false;       // word 0 of every LED is LED_HEADER_BYTE on all lanes
+    static const uint8_t LED_HEADER_BYTE = 0;
+    static const uint32_t TAIL_WORDS = 0;       // after the last LED
+    static const bool WHITE = false;            // W word after B (RGBW), white is extracted at pack time
+    static const uint64_t PERIOD_us = 2500;     // default line period (400Hz): 2.4ms line + reset
+};
+
+struct led_apa102 {     // APA102 / SK9822 (apa102_parallel, data lanes + shared clock)
+    static const uint32_t BIT_HZ = 8000000;
+    static const uint32_t HEAD_WORDS = 4;       // start frame (32 zero bits)
+    static const uint32_t WORDS_PER_LED = 4;
+    static const uint32_t G = 2, R = 3, B = 1;
+    static const bool LED_HEADER = true;
+    static const uint8_t LED_HEADER_BYTE = 0xe0 | 31;   // 0b111 + 5bit global brightness (full)
+    // SK9822 reset frame (32 zero bits), then LENGTH / 2 clocks which shift the data through to the last LED
+    static const uint32_t TAIL_WORDS = 4 + (LENGTH / 2 + 7) / 8;
+    static const bool WHITE = false;
+    static const uint64_t PERIOD_us = 500;      // 2000Hz: 333us line, no reset time, the rest for pack
+};
+
+struct led_sk6812 {     // SK6812 RGBW (ws2812_parallel, 32 bits per LED)
+    static const uint32_t BIT_HZ = 800000;
+    static const uint32_t HEAD_WORDS = 0;
+    static const uint32_t WORDS_PER_LED = 4;
+    static const uint32_t G = 0, R = 1, B = 2, W = 3;
+    static const bool LED_HEADER = false;
+    static const uint8_t LED_HEADER_BYTE = 0;
+    static const uint32_t TAIL_WORDS = 0;
+    static const bool WHITE = true;
+    static const uint64_t PERIOD_us = 3500;     // 285Hz: 3.2ms line + reset
+    // min(R, G, B) moves to W as min * WHITE_GAIN / 256 (lower it if the white die outshines the RGB mix)
+    static const uint32_t WHITE_GAIN = 256;
+};
+
+template<class LED>
+constexpr uint32_t packet_words(){
+    return LED::HEAD_WORDS + LED::WORDS_PER_LED * LENGTH + LED::TAIL_WORDS;
+}
+
+#if OREORE_LED_APA102 && OREORE_LED_RGBW
+#error "OREORE_LED_APA102 and OREORE_LED_RGBW are exclusive"
+#elif OREORE_LED_APA102
+typedef led_apa102 led_strip;
+#elif OREORE_LED_RGBW
+typedef led_sk6812 led_strip;
+#else
+typedef led_ws2812 led_strip;
+#endif
+const uint32_t PACKET_WORDS = packet_words<led_strip>();   // one line, the DMA transfer size
+
+const uint64_t DEFAULT_PERIOD_us = led_strip::PERIOD_us;
+const uint64_t POLL_GPIO_us = 10000;
+const uint32_t PACKET_BUFFERS = 2;      // packet ring
+const uint32_t DMA_REFRESH_LINES = 32;  // OREORE_DMA_SKIP resends an unchanged line at least every 32 lines
+const uint32_t OVERLOAD_CHEAP_LINES = 64;   // lines packed by the cheaper path after an overrun (OVERLOAD_CHEAP)
+const uint32_t DIRTY_FALLBACK_LEDS = 8;     // pack_parallel_dirty stops comparing after this many changed LEDs
+
+// What RUN does when a line is packed after its deadline
+// Lines are triggered on a time grid (deadline += period_us). All policies but SLIP stay on the grid
+// and skip the rows of the slots which passed, so the image keeps its position in time.
+enum overload_policy {
+    OVERLOAD_SLIP = 0,  // send the line late, the grid slides (following lines are late too)
+    OVERLOAD_SKIP,      // send the line late, skip rows to get back on the grid
+    OVERLOAD_REPEAT,    // do not send the late line (LEDs repeat the previous one), skip rows
+    OVERLOAD_CHEAP      // as SKIP, and pack OVERLOAD_CHEAP_LINES lines from one row (multiline images)
+};
+
+struct image_info {
+    // static information
+    // image size should be width * height * 3(RGB) bytes.
+    const uint8_t * image;
+    uint32_t width;     // 240
+    uint32_t height;
+    uint64_t period_us;
+    bool loop;          // Output image repeatedly if true
+    bool mirror;        // Output ABCCBA if true (image = ABC)
+    bool multiline;     // Use multiline poi
+    overload_policy overload;
+
+    image_info(
+        const uint8_t * image_,
+        uint32_t width_,
+        uint32_t height_,
+        uint64_t period_us_ = DEFAULT_PERIOD_us,
+        bool loop_ = true,
+        bool mirror_ = false,
+        bool multiline_ = true,
+        overload_policy overload_ = OVERLOAD_SLIP
+    ) : image(image_), width(width_), height(height_), period_us(period_us_), loop(loop_), mirror(mirror_), multiline(multiline_),
+        overload(overload_) {
+    }
+
+};
+
+extern image_info * const image_table[];
+extern const char * const image_names[];
+extern const uint32_t num_images;
+extern const uint8_t blankline[720];
+
+uint32_t image_id(const image_info * info);
+int get_dip_value();
+image_info * loadImage();
+
+// Render path
+// Packers write the color words of the LEDs only. pack_frame writes the words which never change
+// (start / end frames, LED headers) and is called once per packet buffer.
+uint32_t interleave(const uint8_t v0, const uint8_t v1, const uint8_t v2, const uint8_t v3 = 0);
+template<class LED = led_strip>
+void pack_frame(uint32_t (&packet)[packet_words<LED>()]);
+template<class LED = led_strip>
+void pack_parallel(uint32_t (&packet)[packet_words<LED>()], const uint8_t * line);
+template<class LED = led_strip>
+void pack_parallel_sft(
+    uint32_t (&packet)[packet_words<LED>()],
+    const uint8_t *line0,
+    const uint8_t *line1,
+    const uint8_t *line2,
+    bool reverse = false
+);
+const uint8_t * extractline(const image_info * info, const int32_t y);
+
+// Batched packing (pre-packed images, caches): packs `count` lines per call
+//   pack_lines:     out[k] = pack_parallel(rows[k])
+//   pack_lines_sft: out[k] = pack_parallel_sft(rows[k], rows[k+1], rows[k+2], reverse), rows has count + 2 rows
+template<class LED = led_strip>
+void pack_lines(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()]);
+template<class LED = led_strip>
+void pack_lines_sft(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()], bool reverse = false);
+
+// Packed-domain style of a line (see apply_packed_style)
+const uint32_t PACKED_LANE0 = 0x11111111;   // lane 0 bit of every nibble
+
+struct packed_style {
+    uint32_t shift = 0;     // brightness: value >> shift (>= 8: off)
+    uint32_t mask[4] = {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff};    // G, R, B, W channels
+
+    void mute(const uint32_t lane){
+        for(auto & m : mask){
+            m &= ~(PACKED_LANE0 << lane);
+        }
+    }
+    void solo(const uint32_t lane){
+        for(auto & m : mask){
+            m &= PACKED_LANE0 << lane;
+        }
+    }
+    // channel: 0 = G, 1 = R, 2 = B, 3 = W (RGBW strips) / lanes: bit l enables lane l
+    void channel(const uint32_t channel, const uint32_t lanes){
+        if(channel < 4){
+            mask[channel] &= PACKED_LANE0 * (lanes & 0xf);
+        }
+    }
+    bool identity() const {
+        return shift == 0 && (mask[0] & mask[1] & mask[2] & mask[3]) == 0xffffffff;
+    }
+};
+
+template<class LED = led_strip>
+void apply_packed_style(uint32_t (&dst)[packet_words<LED>()], const uint32_t (&src)[packet_words<LED>()], const packed_style & style);
+template<class LED = led_strip>
+void pack_parallel_dither(
+    uint32_t (&packet)[packet_words<LED>()],
+    const uint8_t * const (&src)[3],
+    const uint32_t brightness,
+    uint8_t (&err)[9*LENGTH]
+);
+template<class LED = led_strip>
+uint32_t pack_parallel_dirty(
+    uint32_t (&packet)[packet_words<LED>()],
+    const uint8_t * const (&prev)[3],
+    const uint8_t * const (&src)[3]
+);
+
+// The packers of each protocol are explicit specializations (they keep HAL_HOT_FUNC, see oreore_poi.cpp)
+#define DECLARE_PACKERS(LED) \
+    template<> void pack_frame<LED>(uint32_t (&packet)[packet_words<LED>()]); \
+    template<> void HAL_HOT_FUNC(pack_parallel)<LED>(uint32_t (&packet)[packet_words<LED>()], const uint8_t * line); \
+    template<> void HAL_HOT_FUNC(pack_parallel_sft)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * line0, const uint8_t * line1, const uint8_t * line2, bool reverse); \
+    template<> void pack_lines<LED>(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()]); \
+    template<> void pack_lines_sft<LED>(const uint8_t * const * rows, uint32_t count, uint32_t (*out)[packet_words<LED>()], bool reverse); \
+    template<> void HAL_HOT_FUNC(apply_packed_style)<LED>(uint32_t (&dst)[packet_words<LED>()], \
+        const uint32_t (&src)[packet_words<LED>()], const packed_style & style); \
+    template<> void HAL_HOT_FUNC(pack_parallel_dither)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * const (&src)[3], const uint32_t brightness, uint8_t (&err)[9*LENGTH]); \
+    template<> uint32_t HAL_HOT_FUNC(pack_parallel_dirty)<LED>(uint32_t (&packet)[packet_words<LED>()], \
+        const uint8_t * const (&prev)[3], const uint8_t * const (&src)[3]);
+
+DECLARE_PACKERS(led_ws2812)
+DECLARE_PACKERS(led_apa102)
+DECLARE_PACKERS(led_sk6812)
+
+// State machine
+struct poi_context {
+    image_info * info;
+    bool reverse;
+    uint32_t (*packets)[PACKET_WORDS];  // packet ring (arena_main): one is packed while DMA sends the other
+    uint32_t cur;                   // packet of the current line
+    int32_t idx;
+    uint32_t pass;      // the number of completed loops
+    bool reported;
+    bool selfbench;     // DIP 15 (OREORE_SELFBENCH)
+    packed_style style; // applied to packed RUN lines
+    uint32_t brightness = 256;      // RUN lines are scaled by brightness / 256 with temporal dithering
+    uint8_t (*dither_err)[9*LENGTH];    // fraction carried to the next line, per byte (arena_scratch_x)
+    const uint8_t * packed_src[PACKET_BUFFERS][3];  // source row of each lane per packet (nullptr: unknown)
+    const uint8_t * sent_src[3];    // source rows of the latched line (nullptr: unknown)
+    uint32_t dma_skipped;   // consecutive RUN lines which were not resent (OREORE_DMA_SKIP)
+    bool scheduled;         // deadline is valid (reset in WAIT)
+    uint32_t deadline;      // DMA trigger time of the next RUN line (hal_time_us32)
+    uint32_t cheap_lines;   // remaining lines of OVERLOAD_CHEAP
+};
+
+extern poi_context poi;
+extern volatile bool psw_pressed;   // set by the push switch IRQ (State WAIT)
+
+void poi_setup();
+void poi_loop_once();
@@ -0,0 +1,116 @@
+// Cycle-level profiling of hot-path stages
+//
+// Enabled by OREORE_PROFILE (cmake -DOREORE_PROFILE=ON). Otherwise every macro compiles to nothing.
+//
+//   PROFILE_SCOPE(PROF_PACK);   // measures until the end of the enclosing scope
+//
+// Counter source:
+//   - Cortex-M33: DWT CYCCNT (1 count = 1 clk_sys cycle)
+//   - x86 host:   rdtsc
+//   - other host: clock_gettime(CLOCK_MONOTONIC) in ns
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum prof_stage {
+    PROF_EXTRACT = 0,   // extractline
+    PROF_PACK,          // interleave / pack_parallel(_sft)
+    PROF_DMA_ARM,       // dma_channel_set_read_addr
+    PROF_SCHEDULE,      // state machine + overload policy
+    PROF_SLEEP,         // sleep_until (idle time left before the line deadline)
+    PROF_NUM_STAGES
+};
+
+#if OREORE_PROFILE
+
+#if defined(__arm__)
+#include "hardware/structs/m33.h"
+
+static inline void prof_counter_init(){
+    m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+    m33_hw->dwt_cyccnt = 0;
+    m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+}
+static inline uint32_t prof_counter(){
+    return m33_hw->dwt_cyccnt;
+}
+#define PROF_UNIT "cycles"
+
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+static inline void prof_counter_init(){}
+static inline uint32_t prof_counter(){
+    return static_cast<uint32_t>(__rdtsc());
+}
+#define PROF_UNIT "tsc"
+
+#else
+#include <time.h>
+
+static inline void prof_counter_init(){}
+static inline uint32_t prof_counter(){
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#define PROF_UNIT "ns"
+
+#endif
+
+struct prof_stats {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+
+    void add(const uint32_t v){
+        if(count == 0 || v < min){
+            min = v;
+        }
+        if(max < v){
+            max = v;
+        }
+        sum += v;
+        count++;
+    }
+};
+
+prof_stats profile[PROF_NUM_STAGES] = {};
+
+struct prof_scope {
+    const prof_stage stage;
+    const uint32_t start;
+
+    prof_scope(const prof_stage s) : stage(s), start(prof_counter()) {}
+    ~prof_scope(){
+        profile[stage].add(prof_counter() - start);
+    }
+};
+
+void profile_dump(){
+    static const char * names[PROF_NUM_STAGES] = {"extract", "pack", "dma_arm", "schedule", "sleep"};
+    printf("# profile [" PROF_UNIT "]\n");
+    printf("stage,count,min,avg,max\n");
+    for(int i=0;i<PROF_NUM_STAGES;i++){
+        const auto & p = profile[i];
+        printf("%s,%lu,%lu,%lu,%lu\n", names[i], (unsigned long)p.count, (unsigned long)p.min,
+            (unsigned long)(p.count ? p.sum / p.count : 0), (unsigned long)p.max);
+    }
+}
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#define PROFILE_INIT() prof_counter_init()
+#define PROFILE_SCOPE(stage) prof_scope PROF_CONCAT(prof_scope_, __LINE__)(stage)
+#define PROFILE_DUMP() profile_dump()
+
+#else
+
+#define PROFILE_INIT() ((void)0)
+#define PROFILE_SCOPE(stage) ((void)0)
+#define PROFILE_DUMP() ((void)0)
+
+#endif
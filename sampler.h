@@ -0,0 +1,141 @@
+// Statistical sampling profiler
+//
+// Enabled by OREORE_SAMPLER (cmake -DOREORE_SAMPLER=ON), sampling period OREORE_SAMPLER_INTERVAL_us.
+// A hardware alarm interrupts the CPU at the highest IRQ priority, and the ISR reads the PC and LR
+// pushed by the exception entry (interrupted code can be thread mode or another ISR).
+// Samples are counted in open-addressing hash tables (PC and LR separately).
+// Dump over USB (SAMPLER_DUMP) or read the "sampler" symbol through SWD, and symbolize with
+// sampler_symbolize.py against build/oreore_poi.elf.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#if OREORE_SAMPLER
+
+#include "hardware/irq.h"
+#include "hardware/timer.h"
+
+#ifndef OREORE_SAMPLER_INTERVAL_us
+#define OREORE_SAMPLER_INTERVAL_us 97   // not a divisor of line periods
+#endif
+
+const uint32_t SAMPLER_MAGIC = 0x31504d53; // "SMP1"
+const uint32_t SAMPLER_PC_SLOTS = 1024;    // must be power of 2
+const uint32_t SAMPLER_LR_SLOTS = 256;     // must be power of 2
+const uint32_t SAMPLER_PROBES = 8;
+
+struct sampler_slot {
+    uint32_t addr;      // 0: empty
+    uint32_t count;
+};
+
+struct sampler_state {
+    // Header (read by sampler_symbolize.py --bin, keep the layout)
+    uint32_t magic = SAMPLER_MAGIC;
+    uint32_t interval_us = OREORE_SAMPLER_INTERVAL_us;
+    uint32_t pc_slots = SAMPLER_PC_SLOTS;
+    uint32_t lr_slots = SAMPLER_LR_SLOTS;
+    volatile uint32_t samples = 0;
+    volatile uint32_t dropped = 0;     // hash table is full around the address
+
+    sampler_slot pc[SAMPLER_PC_SLOTS] = {};
+    sampler_slot lr[SAMPLER_LR_SLOTS] = {};
+
+    uint alarm = 0;
+};
+
+sampler_state sampler;
+
+static __force_inline bool sampler_count(sampler_slot * table, const uint32_t mask, const uint32_t addr){
+    uint32_t h = (addr >> 1) * 2654435761u;
+    for(uint32_t i=0;i<SAMPLER_PROBES;i++){
+        auto & s = table[(h + i) & mask];
+        if(s.addr == addr){
+            s.count++;
+            return true;
+        }
+        if(s.addr == 0){
+            s.addr = addr;
+            s.count = 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+// frame: r0, r1, r2, r3, r12, lr, pc, xpsr stacked by the exception entry
+extern "C" void __not_in_flash_func(sampler_record)(const uint32_t * frame){
+    timer_hw->intr = 1u << sampler.alarm;
+    timer_hw->alarm[sampler.alarm] = timer_hw->timerawl + OREORE_SAMPLER_INTERVAL_us;
+
+    sampler.samples = sampler.samples + 1;
+    if(!sampler_count(sampler.pc, SAMPLER_PC_SLOTS - 1, frame[6])){
+        sampler.dropped = sampler.dropped + 1;
+    }
+    const uint32_t lr = frame[5];
+    if(lr < 0xf0000000u){  // skip EXC_RETURN values
+        sampler_count(sampler.lr, SAMPLER_LR_SLOTS - 1, lr & ~1u);
+    }
+}
+
+// EXC_RETURN bit 2 selects the stack which holds the frame (0: MSP, 1: PSP).
+// LR keeps EXC_RETURN, so sampler_record returns from the exception.
+extern "C" void __attribute__((naked)) __not_in_flash_func(sampler_isr)(){
+    __asm volatile(
+        "tst lr, #4\n"
+        "ite eq\n"
+        "mrseq r0, msp\n"
+        "mrsne r0, psp\n"
+        "b sampler_record\n"
+    );
+}
+
+void sampler_start(){
+    timer_hw->intr = 1u << sampler.alarm;
+    hw_set_bits(&timer_hw->inte, 1u << sampler.alarm);
+    timer_hw->alarm[sampler.alarm] = timer_hw->timerawl + OREORE_SAMPLER_INTERVAL_us;
+}
+
+void sampler_stop(){
+    hw_clear_bits(&timer_hw->inte, 1u << sampler.alarm);
+}
+
+void sampler_init(){
+    sampler.alarm = hardware_alarm_claim_unused(true);
+    const auto irq = hardware_alarm_get_irq_num(sampler.alarm);
+    irq_set_exclusive_handler(irq, sampler_isr);
+    irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(irq, true);
+    sampler_start();
+}
+
+// Raw addresses, symbolized on the host
+void sampler_dump(){
+    sampler_stop();
+    printf("# sampler samples=%lu dropped=%lu interval_us=%lu\n", (unsigned long)sampler.samples,
+        (unsigned long)sampler.dropped, (unsigned long)sampler.interval_us);
+    printf("kind,addr,count\n");
+    for(const auto & s : sampler.pc){
+        if(s.addr){
+            printf("pc,%08lx,%lu\n", (unsigned long)s.addr, (unsigned long)s.count);
+        }
+    }
+    for(const auto & s : sampler.lr){
+        if(s.addr){
+            printf("lr,%08lx,%lu\n", (unsigned long)s.addr, (unsigned long)s.count);
+        }
+    }
+    sampler_start();
+}
+
+#define SAMPLER_INIT() sampler_init()
+#define SAMPLER_DUMP() sampler_dump()
+
+#else
+
+#define SAMPLER_INIT() ((void)0)
+#define SAMPLER_DUMP() ((void)0)
+
+#endif
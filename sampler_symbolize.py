@@ -0,0 +1,137 @@
+# sampler_symbolize.py
+# This script symbolizes samples of the sampling profiler (OREORE_SAMPLER=ON) with the ELF file.
+
+# Usage
+# 1. USB: press the push switch, and samples are printed to USB CDC
+# $ python ./sampler_symbolize.py build/oreore_poi.elf capture.txt
+#
+# 2. SWD: dump "sampler" symbol while the program is running
+# $ arm-none-eabi-nm -S build/oreore_poi.elf | grep " sampler$"
+# $ openocd -f raspberrypi-swd.cfg -f target/rp2350.cfg -c "init; dump_image sampler.bin <address> <size>; exit"
+# $ python ./sampler_symbolize.py build/oreore_poi.elf --bin sampler.bin
+#
+# Options
+#   --lines   resolve hot addresses to file:line with addr2line
+#   --top N   number of rows (default 30)
+# Tools are arm-none-eabi-nm / addr2line (set TOOLCHAIN_PREFIX to override the prefix).
+
+import bisect
+import os
+import struct
+import subprocess
+import sys
+
+SAMPLER_MAGIC = 0x31504d53
+PREFIX = os.environ.get('TOOLCHAIN_PREFIX', 'arm-none-eabi-')
+
+def parse_text(lines):
+  header = []
+  samples = {'pc': {}, 'lr': {}}
+  for line in lines:
+    line = line.strip()
+    if line.startswith('# sampler'):
+      header = [line]
+      samples = {'pc': {}, 'lr': {}}
+      continue
+    v = line.split(',')
+    if len(v) == 3 and v[0] in samples:
+      try:
+        samples[v[0]][int(v[1], 16)] = int(v[2])
+      except ValueError:
+        pass
+  return header, samples
+
+def parse_bin(data):
+  magic, interval, pc_slots, lr_slots, total, dropped = struct.unpack_from('<6I', data, 0)
+  if magic != SAMPLER_MAGIC:
+    sys.exit('sampler magic not found')
+  header = ['# sampler samples=%d dropped=%d interval_us=%d' % (total, dropped, interval)]
+  samples = {'pc': {}, 'lr': {}}
+  offset = 24
+  for kind, slots in (('pc', pc_slots), ('lr', lr_slots)):
+    for i in range(slots):
+      addr, count = struct.unpack_from('<2I', data, offset + i * 8)
+      if addr:
+        samples[kind][addr] = count
+    offset += slots * 8
+  return header, samples
+
+def load_symbols(elf):
+  out = subprocess.run([PREFIX + 'nm', '-n', '-S', '-C', elf], capture_output=True, text=True, check=True).stdout
+  symbols = []
+  for line in out.splitlines():
+    v = line.split(maxsplit=3)
+    if len(v) == 4 and v[2] in 'tTwW':
+      symbols.append((int(v[0], 16) & ~1, int(v[1], 16), v[3]))
+  symbols.sort()
+  return symbols
+
+def lookup(symbols, starts, addr):
+  i = bisect.bisect_right(starts, addr) - 1
+  if i >= 0:
+    start, size, name = symbols[i]
+    if addr < start + max(size, 2):
+      return name
+  return '?%08x' % addr
+
+def addr2line(elf, addrs):
+  if not addrs:
+    return {}
+  out = subprocess.run([PREFIX + 'addr2line', '-e', elf] + ['%x' % a for a in addrs],
+                       capture_output=True, text=True, check=True).stdout.splitlines()
+  return dict(zip(addrs, out))
+
+def region(addr):
+  if 0x10000000 <= addr < 0x14000000:
+    return 'flash'
+  if 0x20000000 <= addr < 0x20082000:
+    return 'sram'
+  if addr < 0x8000:
+    return 'rom'
+  return '?'
+
+def main():
+  args = sys.argv[1:]
+  lines = '--lines' in args
+  if lines:
+    args.remove('--lines')
+  top = 30
+  if '--top' in args:
+    i = args.index('--top')
+    top = int(args[i + 1])
+    del args[i:i + 2]
+  if len(args) == 3 and args[1] == '--bin':
+    header, samples = parse_bin(open(args[2], 'rb').read())
+  elif len(args) == 2:
+    header, samples = parse_text(open(args[1]).readlines())
+  else:
+    sys.exit('usage: sampler_symbolize.py ELF [--bin FILE | FILE] [--lines] [--top N]')
+  elf = args[0]
+
+  for line in header:
+    print(line)
+  symbols = load_symbols(elf)
+  starts = [s[0] for s in symbols]
+
+  for kind, title in (('pc', 'self (PC)'), ('lr', 'caller (LR)')):
+    total = sum(samples[kind].values())
+    if total == 0:
+      continue
+    per_func = {}
+    for addr, count in samples[kind].items():
+      name = lookup(symbols, starts, addr)
+      per_func[name] = per_func.get(name, 0) + count
+    print('\n%s: %d samples' % (title, total))
+    print('%7s %8s  %s' % ('%', 'samples', 'function'))
+    for name, count in sorted(per_func.items(), key=lambda x: -x[1])[:top]:
+      print('%6.2f%% %8d  %s' % (count * 100.0 / total, count, name))
+
+    if lines and kind == 'pc':
+      hot = sorted(samples['pc'].items(), key=lambda x: -x[1])[:top]
+      where = addr2line(elf, [a for a, _ in hot])
+      print('\nhot addresses')
+      for addr, count in hot:
+        print('%6.2f%% %08x %-5s %s' % (count * 100.0 / total, addr, region(addr), where.get(addr, '')))
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,250 @@
+// On-device self benchmark
+//
+// Enabled by OREORE_SELFBENCH (cmake -DOREORE_SELFBENCH=ON, off by default) and selected by DIP 15
+// (low nibble, all four switches off: inputs are pulled up). DIP 15 otherwise draws blue, the idle
+// position of a stock build, so only builds made for benchmarking use it. Runs once after boot instead of drawing images:
+//
+//   <kernel>                   each packing kernel over each image, source in flash (as in playback)
+//   pack_parallel_sft_warm     SELFBENCH_ROWS rows repeatedly from flash (fit in the XIP cache)
+//   pack_parallel_sft_sram     the same rows copied to SRAM
+//   pack_parallel_sft_cold     the same rows, XIP cache invalidated before every line
+//                              (includes refills of the code running from flash)
+//   dma                        DMA transfer of one blank line (LEDs stay off)
+//
+// Results are printed over USB CDC (same CSV as `oreore_sim bench`, capacity_model.py reads it)
+// when the host connects and every time the push switch is pressed.
+// USR_LED_PIN always blinks a summary in us per line (average over images):
+//   flash, warm, sram, cold, dma
+// Each value is blinked as decimal digits (digit n = n short blinks, 0 = 10 blinks) after a long
+// blink, with pauses between digits.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "deadline.h"
+#include "arena.h"
+
+#if OREORE_SELFBENCH
+
+const int SELFBENCH_DIP = 15;
+const uint32_t SELFBENCH_ITERATIONS = 64;
+const uint32_t SELFBENCH_DMA_ITERATIONS = 8;
+const uint32_t SELFBENCH_ROWS = 8;
+const uint32_t SELFBENCH_MAX_RESULTS = 64;
+
+enum selfbench_summary {
+    SB_FLASH = 0, SB_WARM, SB_SRAM, SB_COLD, SB_DMA, SB_NUM_SUMMARY
+};
+
+struct selfbench_result {
+    const char * kernel;
+    const char * image;
+    uint32_t ns_per_line;
+};
+
+// Blink pattern: alternating on / off durations [ms], starting with on
+struct selfbench_blinker {
+    // A value takes a long blink and up to 10 digits of up to 10 blinks (0), on + off each
+    static const uint32_t MAX_PER_VALUE = 2 + 10 * 10 * 2;
+    static const uint32_t MAX = SB_NUM_SUMMARY * MAX_PER_VALUE;
+    uint16_t ms[MAX];
+    uint32_t count = 0;
+    uint32_t pos = 0;
+    uint32_t since = 0;
+
+    void add(const uint16_t on, const uint16_t off){
+        if(count + 2 <= MAX){
+            ms[count++] = on;
+            ms[count++] = off;
+        }
+    }
+
+    void add_value(uint32_t v){
+        char digits[12];
+        snprintf(digits, sizeof(digits), "%lu", (unsigned long)v);
+        uint32_t need = 2;
+        for(const char * d=digits;*d;d++){
+            need += 2 * (*d == '0' ? 10 : *d - '0');
+        }
+        if(count + need > MAX){
+            return;     // only whole values are blinked
+        }
+        add(1500, 1000);
+        for(const char * d=digits;*d;d++){
+            const int n = *d == '0' ? 10 : *d - '0';
+            for(int i=0;i<n;i++){
+                add(150, i + 1 < n ? 250 : 1000);
+            }
+        }
+        ms[count - 1] = 2500;
+    }
+
+    bool level(const uint32_t now_ms){
+        if(count == 0){
+            return false;
+        }
+        while(now_ms - since >= ms[pos]){
+            since += ms[pos];
+            pos = (pos + 1) % count;
+        }
+        return (pos & 1) == 0;
+    }
+};
+
+struct selfbench {
+    selfbench_result results[SELFBENCH_MAX_RESULTS];
+    uint32_t count = 0;
+    uint32_t summary_ns[SB_NUM_SUMMARY] = {};
+    bool done = false;
+    bool reported = false;
+    selfbench_blinker blinker;
+
+    uint32_t packet[PACKET_WORDS];
+    uint8_t (*rows)[720] = nullptr;     // staging rows in arena_main while run() is running
+
+    void add(const char * kernel, const char * image, const uint32_t us, const uint32_t n){
+        if(count < SELFBENCH_MAX_RESULTS){
+            results[count++] = {kernel, image, static_cast<uint32_t>(static_cast<uint64_t>(us) * 1000 / n)};
+        }
+    }
+
+    template<typename F>
+    uint32_t measure(F && pack){
+        for(uint32_t n=0;n<SELFBENCH_ITERATIONS/8;n++){  // warm up
+            pack(n);
+        }
+        const auto t0 = hal_time_us32();
+        for(uint32_t n=0;n<SELFBENCH_ITERATIONS;n++){
+            pack(n);
+        }
+        return hal_time_us32() - t0;
+    }
+
+    void run(image_info * const * images, const char * const * names, const uint32_t num){
+        arena_scope scope(arena_main);
+        rows = arena_main.alloc<uint8_t[720]>("selfbench rows", SELFBENCH_ROWS + 2);   // + 2 for pack_parallel_sft
+        uint64_t sum[SB_NUM_SUMMARY] = {};
+        for(uint32_t i=0;i<num;i++){
+            const auto info = images[i];
+            const auto h = info->height;
+
+            // Playback: sweep the image from flash
+            uint32_t us = measure([&](uint32_t n){
+                pack_parallel(packet, extractline(info, n % h));
+            });
+            add("pack_parallel", names[i], us, SELFBENCH_ITERATIONS);
+            us = measure([&](uint32_t n){
+                pack_parallel_sft(packet, extractline(info, n % h), extractline(info, n % h + 1), extractline(info, n % h + 2), false);
+            });
+            add("pack_parallel_sft", names[i], us, SELFBENCH_ITERATIONS);
+            sum[SB_FLASH] += us;
+            us = measure([&](uint32_t n){
+                pack_parallel_sft(packet, extractline(info, n % h), extractline(info, n % h + 1), extractline(info, n % h + 2), true);
+            });
+            add("pack_parallel_sft_reverse", names[i], us, SELFBENCH_ITERATIONS);
+
+            // A few rows: flash (warm) vs SRAM
+            us = measure([&](uint32_t n){
+                const auto y = n % SELFBENCH_ROWS;
+                pack_parallel_sft(packet, extractline(info, y), extractline(info, y + 1), extractline(info, y + 2), false);
+            });
+            add("pack_parallel_sft_warm", names[i], us, SELFBENCH_ITERATIONS);
+            sum[SB_WARM] += us;
+
+            for(uint32_t y=0;y<SELFBENCH_ROWS+2;y++){
+                memcpy(rows[y], extractline(info, y), sizeof(rows[y]));
+            }
+            us = measure([&](uint32_t n){
+                const auto y = n % SELFBENCH_ROWS;
+                pack_parallel_sft(packet, rows[y], rows[y + 1], rows[y + 2], false);
+            });
+            add("pack_parallel_sft_sram", names[i], us, SELFBENCH_ITERATIONS);
+            sum[SB_SRAM] += us;
+
+            // Cold: every line is timed separately after the invalidation
+            us = 0;
+            for(uint32_t n=0;n<SELFBENCH_ITERATIONS;n++){
+                const auto y = n % SELFBENCH_ROWS;
+                hal_xip_cache_invalidate();
+                const auto t0 = hal_time_us32();
+                pack_parallel_sft(packet, extractline(info, y), extractline(info, y + 1), extractline(info, y + 2), false);
+                us += hal_time_us32() - t0;
+            }
+            add("pack_parallel_sft_cold", names[i], us, SELFBENCH_ITERATIONS);
+            sum[SB_COLD] += us;
+        }
+
+        // DMA: blank line, from trigger to the last word in the PIO FIFO
+        pack_frame(packet);
+        pack_parallel(packet, blankline);
+        while(hal_dma_busy()){
+            hal_sleep_us(1);
+        }
+        uint32_t us = 0;
+        for(uint32_t n=0;n<SELFBENCH_DMA_ITERATIONS;n++){
+            const auto t0 = hal_time_us32();
+            hal_dma_start(packet);
+            while(hal_dma_busy()){
+                hal_sleep_us(1);
+            }
+            us += hal_time_us32() - t0;
+        }
+        add("dma", "blank", us, SELFBENCH_DMA_ITERATIONS);
+
+        for(uint32_t s=0;s<SB_DMA;s++){
+            summary_ns[s] = static_cast<uint32_t>(sum[s] * 1000 / (SELFBENCH_ITERATIONS * (num ? num : 1)));
+        }
+        summary_ns[SB_DMA] = static_cast<uint64_t>(us) * 1000 / SELFBENCH_DMA_ITERATIONS;
+        for(auto ns : summary_ns){
+            blinker.add_value((ns + 500) / 1000);
+        }
+        blinker.since = hal_time_us32() / 1000;
+        done = true;
+        rows = nullptr;
+    }
+
+    void report(){
+        static const char * summary_names[SB_NUM_SUMMARY] = {"flash", "warm", "sram", "cold", "dma"};
+        printf("# selfbench iterations=%lu rows=%lu summary(us/line)", (unsigned long)SELFBENCH_ITERATIONS,
+            (unsigned long)SELFBENCH_ROWS);
+        for(uint32_t s=0;s<SB_NUM_SUMMARY;s++){
+            printf(" %s=%lu.%03lu", summary_names[s], (unsigned long)(summary_ns[s] / 1000),
+                (unsigned long)(summary_ns[s] % 1000));
+        }
+        printf("\n");
+        printf("kernel,image,ns_per_line\n");
+        for(uint32_t i=0;i<count;i++){
+            printf("%s,%s,%lu\n", results[i].kernel, results[i].image, (unsigned long)results[i].ns_per_line);
+        }
+    }
+
+    // Called from the main loop every POLL_GPIO_us
+    void poll(const uint led_pin, const bool report_requested){
+        if(!done){
+            return;
+        }
+        if(report_requested || (!reported && hal_stdio_connected())){
+            DEADLINE_REPORT_BEGIN();
+            report();
+            DEADLINE_REPORT_END();
+            reported = true;
+        }
+        hal_gpio_put(led_pin, blinker.level(hal_time_us32() / 1000));
+    }
+};
+
+selfbench self_bench;
+
+#define SELFBENCH_SELECTED(dip) (((dip) & 0xf) == SELFBENCH_DIP)
+#define SELFBENCH_RUN(images, names, num) self_bench.run((images), (names), (num))
+#define SELFBENCH_POLL(led_pin, report) self_bench.poll((led_pin), (report))
+
+#else
+
+#define SELFBENCH_SELECTED(dip) false
+#define SELFBENCH_RUN(images, names, num) ((void)0)
+#define SELFBENCH_POLL(led_pin, report) ((void)0)
+
+#endif
@@ -0,0 +1,8 @@
+// Subcommands of oreore_sim (argc / argv exclude the subcommand name)
+
+#pragma once
+
+int pio_verify(int argc, char ** argv);
+int digest(int argc, char ** argv);
+int preview(int argc, char ** argv);
+int latency_sim(int argc, char ** argv);
@@ -0,0 +1,197 @@
+// oreore_sim digest: golden bitstream digests of the packers
+//
+// Every bundled image is packed by each kernel over one loop (plus blank lines before / after),
+// and the firmware loop is run in normal and reverse mode. The packed words are
+// hashed (FNV-1a 64) per case, so an optimized kernel can be compared with the reference
+// implementation without keeping the bitstreams.
+//
+// $ oreore_sim digest                     prints digests
+// $ oreore_sim digest --update FILE       writes digests to FILE
+// $ oreore_sim digest --check FILE        compares with FILE, exit code 1 if any case differs
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "poi.h"
+#include "sim.h"
+#include "commands.h"
+
+namespace {
+
+struct fnv1a {
+    uint64_t h = 0xcbf29ce484222325ull;
+    uint64_t words = 0;
+
+    void add(const uint32_t * w, const uint32_t count){
+        for(uint32_t i=0;i<count;i++){
+            for(uint32_t b=0;b<4;b++){
+                h = (h ^ ((w[i] >> (8 * b)) & 0xff)) * 0x100000001b3ull;
+            }
+        }
+        words += count;
+    }
+};
+
+struct digest_case {
+    std::string name;
+    uint64_t digest;
+    uint64_t words;
+};
+
+// DIP values which select each image in loadImage (+16: reverse)
+const struct {
+    const char * image;
+    int dip;
+} dip_images[] = {
+    {"bluewave", 8}, {"symbol", 9}, {"rainbow", 10}, {"red", 11}, {"green", 13}, {"blue", 14},
+};
+
+std::vector<digest_case> compute(){
+    std::vector<digest_case> cases;
+    static uint32_t packet[PACKET_WORDS];
+
+    // Kernels
+    for(uint32_t i=0;i<num_images;i++){
+        const auto info = image_table[i];
+        const int32_t limit = info->mirror ? info->height * 2 : info->height;
+        auto sweep = [&](const char * kernel, auto && pack){
+            fnv1a h;
+            for(int32_t y=-2;y<limit+2;y++){
+                pack(y);
+                h.add(packet, PACKET_WORDS);
+            }
+            cases.push_back({std::string("kernel/") + kernel + "/" + image_names[i], h.h, h.words});
+        };
+        sweep("pack_parallel", [&](int32_t y){
+            pack_parallel(packet, extractline(info, y));
+        });
+        sweep("pack_parallel_sft", [&](int32_t y){
+            pack_parallel_sft(packet, extractline(info, y), extractline(info, y+1), extractline(info, y+2), false);
+        });
+        sweep("pack_parallel_sft_reverse", [&](int32_t y){
+            pack_parallel_sft(packet, extractline(info, y), extractline(info, y+1), extractline(info, y+2), true);
+        });
+
+        // Batched kernels pack the same sweep in one call
+        std::vector<const uint8_t *> rows;
+        for(int32_t y=-2;y<limit+4;y++){
+            rows.push_back(extractline(info, y));
+        }
+        const uint32_t count = limit + 4;
+        std::vector<uint32_t> packed(count * PACKET_WORDS);
+        auto out = reinterpret_cast<uint32_t (*)[PACKET_WORDS]>(packed.data());
+        auto batch = [&](const char * kernel){
+            fnv1a h;
+            h.add(packed.data(), packed.size());
+            cases.push_back({std::string("kernel/") + kernel + "/" + image_names[i], h.h, h.words});
+        };
+        pack_lines(rows.data(), count, out);
+        batch("pack_lines");
+        pack_lines_sft(rows.data(), count, out, false);
+        batch("pack_lines_sft");
+        pack_lines_sft(rows.data(), count, out, true);
+        batch("pack_lines_sft_reverse");
+    }
+
+    // Firmware loop: RUN lines after boot (2 loops if the image loops)
+    for(const auto & d : dip_images){
+        for(int reverse=0;reverse<2;reverse++){
+            fnv1a h;
+            sim_set_output([&](const uint32_t * words, uint32_t count, uint64_t){
+                h.add(words, count);
+            });
+            poi = {};
+            sim_set_dip(d.dip + (reverse ? 16 : 0));
+            poi_setup();
+            const auto info = poi.info;
+            const uint32_t lines = (info->mirror ? info->height * 2 : info->height) * (info->loop ? 2 : 1);
+            while(h.words < static_cast<uint64_t>(lines) * PACKET_WORDS){
+                poi_loop_once();
+            }
+            cases.push_back({std::string("loop/") + (reverse ? "reverse/" : "normal/") + d.image, h.h, h.words});
+        }
+    }
+    sim_set_output(nullptr);
+    return cases;
+}
+
+void write(FILE * f, const std::vector<digest_case> & cases){
+    fprintf(f, "# case fnv1a64 words (generated by oreore_sim digest --update)\n");
+    for(const auto & c : cases){
+        fprintf(f, "%s %016llx %llu\n", c.name.c_str(), (unsigned long long)c.digest, (unsigned long long)c.words);
+    }
+}
+
+}
+
+int digest(int argc, char ** argv){
+    const char * check_file = nullptr;
+    const char * update_file = nullptr;
+    for(int i=0;i<argc;i++){
+        if(strcmp(argv[i], "--check") == 0 && i + 1 < argc){
+            check_file = argv[++i];
+        }else if(strcmp(argv[i], "--update") == 0 && i + 1 < argc){
+            update_file = argv[++i];
+        }else{
+            fprintf(stderr, "usage: oreore_sim digest [--check FILE | --update FILE]\n");
+            return 2;
+        }
+    }
+
+    const auto cases = compute();
+
+    if(update_file){
+        FILE * f = fopen(update_file, "w");
+        if(!f){
+            perror(update_file);
+            return 1;
+        }
+        write(f, cases);
+        fclose(f);
+        printf("%zu cases written to %s\n", cases.size(), update_file);
+        return 0;
+    }
+    if(!check_file){
+        write(stdout, cases);
+        return 0;
+    }
+
+    FILE * f = fopen(check_file, "r");
+    if(!f){
+        perror(check_file);
+        return 1;
+    }
+    std::map<std::string, std::pair<uint64_t, uint64_t>> golden;
+    char line[256];
+    while(fgets(line, sizeof(line), f)){
+        char name[128];
+        unsigned long long d, w;
+        if(line[0] != '#' && sscanf(line, "%127s %llx %llu", name, &d, &w) == 3){
+            golden[name] = {d, w};
+        }
+    }
+    fclose(f);
+
+    uint32_t failed = 0;
+    for(const auto & c : cases){
+        const auto g = golden.find(c.name);
+        if(g == golden.end()){
+            printf("MISSING %s\n", c.name.c_str());
+            failed++;
+        }else if(g->second.first != c.digest || g->second.second != c.words){
+            printf("DIFF %s %016llx (golden %016llx)\n", c.name.c_str(),
+                (unsigned long long)c.digest, (unsigned long long)g->second.first);
+            failed++;
+        }
+        if(g != golden.end()){
+            golden.erase(g);
+        }
+    }
+    for(const auto & g : golden){
+        printf("UNKNOWN %s\n", g.first.c_str());
+    }
+    printf("%zu cases, %lu failed: %s\n", cases.size(), (unsigned long)failed, failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
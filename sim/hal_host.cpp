@@ -0,0 +1,393 @@
+// Host (Linux) implementation of hal.h
+//
+// Time is virtual: hal_sleep_us advances the clock immediately, so the firmware runs faster than real time.
+// Pending events (push switch edges, DMA completion) are processed in time order while the clock advances.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "hal.h"
+#include "sim.h"
+#include "trace.h"
+
+namespace {
+
+const uint32_t PIO_FIFO_DEPTH = 8;      // TX FIFO joined
+const uint32_t GPIO_IRQ_EDGE_FALL = 0x4;
+const uint32_t CDC_FIFO_BYTES = 256;        // CFG_TUD_CDC_TX_BUFSIZE of the pico SDK
+const uint32_t CDC_BYTES_PER_MS = 1000;     // USB full speed bulk, roughly
+
+struct gpio_event {
+    uint64_t t_us;
+    uint32_t set;       // pins set to 1
+    uint32_t clear;     // pins set to 0
+};
+
+struct host_state {
+    uint64_t now_us = 0;
+    uint32_t gpio_in = 1u << 7;   // push switch is released (pulled up)
+    uint32_t gpio_out = 0;
+    std::vector<gpio_event> events;   // sorted by time
+
+    hal_gpio_cbk gpio_cbk = nullptr;
+    uint32_t gpio_irq_pins = 0;
+
+    uint32_t pio_pin_count = 0;
+    float pio_freq = 800000;
+    uint32_t dma_words = 0;
+    bool dma_active = false;
+    uint64_t dma_end_us = 0;
+    hal_irq_handler dma_irq = nullptr;
+
+    double cost_scale = 0;
+    double cost_acc_us = 0;
+    std::chrono::steady_clock::time_point mark = std::chrono::steady_clock::now();
+
+    sim_output_cbk output;
+    sim_stats stats = {};
+
+    FILE * cdc = nullptr;
+    uint64_t cdc_drained_us = 0;    // the FIFO is empty at this time
+
+    trace_writer * trace = nullptr;
+    uint64_t work_start_us = 0;     // end of the last sleep
+
+    std::vector<sim_replay_line> replay;
+    size_t replay_pos = 0;
+    const sim_replay_line * line = nullptr;    // replayed line until its DMA trigger
+    uint64_t stage_us = 0;          // the last hal_stage_mark
+};
+
+host_state host;
+
+void set_gpio(uint32_t value){
+    const auto fall = host.gpio_in & ~value;
+    host.gpio_in = value;
+    if(host.gpio_cbk){
+        for(uint pin=0;pin<32;pin++){
+            if((fall & host.gpio_irq_pins) & (1u << pin)){
+                if(host.trace){
+                    host.trace->instant(TRACE_IRQ, "gpio_fall", host.now_us, "\"pin\":" + std::to_string(pin));
+                }
+                host.gpio_cbk(pin, GPIO_IRQ_EDGE_FALL);
+            }
+        }
+    }
+}
+
+// Processes events until `until` and moves the clock
+void advance(const uint64_t until){
+    while(true){
+        uint64_t next = until;
+        if(host.dma_active && host.dma_end_us <= next){
+            next = host.dma_end_us;
+        }
+        if(!host.events.empty() && host.events.front().t_us <= next){
+            next = host.events.front().t_us;
+        }
+        host.now_us = std::max(host.now_us, next);
+
+        if(host.dma_active && host.dma_end_us <= host.now_us){
+            host.dma_active = false;
+            if(host.dma_irq){
+                if(host.trace){
+                    host.trace->instant(TRACE_IRQ, "dma_irq", host.now_us);
+                }
+                host.stats.dma_irqs++;
+                host.dma_irq();
+            }
+            continue;
+        }
+        if(!host.events.empty() && host.events.front().t_us <= host.now_us){
+            const auto e = host.events.front();
+            host.events.erase(host.events.begin());
+            set_gpio((host.gpio_in | e.set) & ~e.clear);
+            continue;
+        }
+        if(next == until){
+            return;
+        }
+    }
+}
+
+// Charges host time spent since the previous HAL call to the virtual clock
+struct charge {
+    charge(){
+        if(host.cost_scale > 0){
+            const auto t = std::chrono::steady_clock::now();
+            host.cost_acc_us += std::chrono::duration<double, std::micro>(t - host.mark).count() * host.cost_scale;
+            const auto whole = static_cast<uint64_t>(host.cost_acc_us);
+            host.cost_acc_us -= whole;
+            advance(host.now_us + whole);
+        }
+    }
+    ~charge(){
+        host.mark = std::chrono::steady_clock::now();
+    }
+};
+
+uint64_t word_ns(){
+    // ws2812_parallel outputs 4 bits (one per lane) per LED bit period
+    return static_cast<uint64_t>(32 / std::max(host.pio_pin_count, 1u) * 1e9 / host.pio_freq);
+}
+
+}
+
+//-----------------------------------------
+// hal.h
+
+void hal_stdio_init(){
+}
+
+void hal_gpio_init_input(uint pin){
+    charge c;
+}
+
+void hal_gpio_init_output(uint pin){
+    charge c;
+    host.gpio_out &= ~(1u << pin);
+}
+
+void hal_gpio_set_irq_falling(uint pin, hal_gpio_cbk cbk){
+    charge c;
+    host.gpio_cbk = cbk;
+    host.gpio_irq_pins |= 1u << pin;
+}
+
+uint32_t hal_gpio_get_all(){
+    charge c;
+    return host.gpio_in | host.gpio_out;
+}
+
+bool hal_gpio_get(uint pin){
+    charge c;
+    return ((host.gpio_in | host.gpio_out) >> pin) & 1;
+}
+
+void hal_gpio_put(uint pin, bool value){
+    charge c;
+    if(value){
+        host.gpio_out |= 1u << pin;
+    }else{
+        host.gpio_out &= ~(1u << pin);
+    }
+}
+
+void hal_pio_init(uint pin_base, uint pin_count, float freq){
+    charge c;
+    host.pio_pin_count = pin_count;
+    host.pio_freq = freq;
+}
+
+// One bit of every lane per clock as ws2812_parallel, the word time is the same
+void hal_pio_init_clocked(uint pin_base, uint pin_count, uint clock_pin, float freq){
+    hal_pio_init(pin_base, pin_count, freq);
+}
+
+void hal_dma_init(uint32_t words){
+    charge c;
+    host.dma_words = words;
+}
+
+void hal_dma_start(const uint32_t * packet){
+    charge c;
+    const auto line = host.line;
+    host.line = nullptr;
+    if(line){
+        advance(host.now_us + line->trigger_us);
+    }
+    if(host.dma_active){
+        host.stats.dma_overlaps++;
+        if(host.trace){
+            host.trace->instant(TRACE_IRQ, "dma_overlap", host.now_us);
+        }
+    }
+    host.stats.lines++;
+    if(host.output){
+        host.output(packet, host.dma_words, host.now_us);
+    }
+    // DMA completes when the last word enters the FIFO
+    const auto words = host.dma_words > PIO_FIFO_DEPTH ? host.dma_words - PIO_FIFO_DEPTH : 0;
+    uint64_t dur_us = (words * word_ns() + 999) / 1000;
+    if(line && line->dma_us > dur_us){
+        dur_us = line->dma_us;
+    }
+    host.dma_active = true;
+    host.dma_end_us = host.now_us + dur_us;
+    if(host.trace){
+        host.trace->span(TRACE_DMA, "dma", host.now_us, host.dma_end_us - host.now_us,
+            "\"words\":" + std::to_string(host.dma_words));
+    }
+}
+
+bool hal_dma_busy(){
+    charge c;
+    return host.dma_active;
+}
+
+void hal_dma_set_irq(hal_irq_handler handler){
+    charge c;
+    host.dma_irq = handler;
+}
+
+uint32_t hal_time_us32(){
+    charge c;
+    return static_cast<uint32_t>(host.now_us);
+}
+
+void hal_sleep_us(uint64_t us){
+    charge c;
+    if(host.trace){
+        if(host.now_us > host.work_start_us){
+            host.trace->span(TRACE_CORE0, "work", host.work_start_us, host.now_us - host.work_start_us);
+        }
+        if(us > 0){
+            host.trace->span(TRACE_CORE0, "sleep", host.now_us, us);
+        }
+    }
+    advance(host.now_us + us);
+    host.work_start_us = host.now_us;
+}
+
+void hal_stage_mark(hal_line_stage stage){
+    charge c;
+    static const char * names[] = {"", "fetch", "pack"};
+    if(stage == HAL_STAGE_BEGIN){
+        host.line = nullptr;
+        if(!host.replay.empty()){
+            host.line = &host.replay[host.replay_pos++ % host.replay.size()];
+            host.stats.replayed++;
+            if(host.trace && host.line->events){
+                host.trace->instant(TRACE_IRQ, "replay_events", host.now_us,
+                    "\"events\":" + std::to_string(host.line->events));
+            }
+        }
+    }else{
+        if(host.line){
+            const auto cost = stage == HAL_STAGE_FETCHED ? host.line->fetch_us : host.line->pack_us;
+            if(host.stage_us + cost > host.now_us){
+                advance(host.stage_us + cost);
+            }
+        }
+        if(host.trace){
+            host.trace->span(TRACE_CORE0, names[stage], host.stage_us, host.now_us - host.stage_us);
+        }
+    }
+    host.stage_us = host.now_us;
+}
+
+bool hal_stdio_connected(){
+    return true;    // stdout
+}
+
+void hal_xip_cache_invalidate(){
+}
+
+void hal_panic(const char * fmt, ...){
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    abort();
+}
+
+// FIFO drains at CDC_BYTES_PER_MS while a host is connected
+uint32_t hal_cdc_write_available(){
+    charge c;
+    if(!host.cdc){
+        return 0;
+    }
+    const auto now = host.now_us;
+    const uint64_t queued = host.cdc_drained_us > now ? (host.cdc_drained_us - now) * CDC_BYTES_PER_MS / 1000 : 0;
+    return queued < CDC_FIFO_BYTES ? CDC_FIFO_BYTES - queued : 0;
+}
+
+uint32_t hal_cdc_write(const void * buf, uint32_t n){
+    const auto avail = hal_cdc_write_available();
+    n = std::min(n, avail);
+    if(n == 0){
+        return 0;
+    }
+    fwrite(buf, 1, n, host.cdc);
+    host.cdc_drained_us = std::max(host.cdc_drained_us, host.now_us) + n * 1000 / CDC_BYTES_PER_MS;
+    return n;
+}
+
+void hal_cdc_flush(){
+    if(host.cdc){
+        fflush(host.cdc);
+    }
+}
+
+//-----------------------------------------
+// sim.h
+
+// DIP bits are read from GPIO0, 1, 2, 4, 3 (see get_dip_value)
+static uint32_t dip_raw(int value){
+    const uint32_t masks[] = {0x01, 0x02, 0x04, 0x10, 0x08};
+    uint32_t raw = 0;
+    for(int i=0;i<5;i++){
+        if(value & (1 << i)){
+            raw |= masks[i];
+        }
+    }
+    return raw;
+}
+
+void sim_set_dip(int value){
+    host.gpio_in = (host.gpio_in & ~0x1fu) | dip_raw(value);
+}
+
+void sim_press(uint64_t at_us, uint64_t hold_us, int dip){
+    const uint32_t psw = 1u << 7;
+    host.events.push_back({at_us, 0, psw});
+    if(dip >= 0){
+        const auto raw = dip_raw(dip);
+        host.events.push_back({at_us + hold_us / 2, raw, 0x1fu & ~raw});
+    }
+    host.events.push_back({at_us + hold_us, psw, 0});
+    std::stable_sort(host.events.begin(), host.events.end(),
+        [](const gpio_event & a, const gpio_event & b){ return a.t_us < b.t_us; });
+}
+
+void sim_set_cost_scale(double scale){
+    host.cost_scale = scale;
+    host.mark = std::chrono::steady_clock::now();
+}
+
+void sim_set_replay(const std::vector<sim_replay_line> & lines){
+    host.replay = lines;
+    host.replay_pos = 0;
+    host.line = nullptr;
+}
+
+void sim_set_output(sim_output_cbk cbk){
+    host.output = cbk;
+}
+
+void sim_set_cdc(FILE * f){
+    host.cdc = f;
+    host.cdc_drained_us = host.now_us;
+}
+
+void sim_set_trace(trace_writer * trace){
+    host.trace = trace;
+    host.work_start_us = host.now_us;
+}
+
+uint64_t sim_now_us(){
+    return host.now_us;
+}
+
+uint64_t sim_word_ns(){
+    return word_ns();
+}
+
+const sim_stats & sim_get_stats(){
+    return host.stats;
+}
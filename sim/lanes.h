@@ -0,0 +1,33 @@
+// Decodes ws2812_parallel FIFO words back to per-lane LED values (inverse of interleave)
+
+#pragma once
+
+#include <stdint.h>
+#include "poi.h"
+
+struct lane_grb {
+    uint8_t g;
+    uint8_t r;
+    uint8_t b;
+    uint8_t w;      // RGBW strips (led_sk6812), 0 otherwise
+};
+
+// Nibble k of a word holds bit (7 - k) of all lanes, lane n is bit n of the nibble
+static inline uint8_t lane_byte(const uint32_t word, const uint32_t lane){
+    uint8_t v = 0;
+    for(uint32_t k=0;k<8;k++){
+        v = (v << 1) | ((word >> (4 * k + lane)) & 1);
+    }
+    return v;
+}
+
+// LED `led` of lane `lane` in a packet of protocol LED (led_strip: the packets of the firmware)
+template<class LED = led_strip>
+static inline lane_grb lane_led(const uint32_t * words, const uint32_t led, const uint32_t lane){
+    const uint32_t * w = words + LED::HEAD_WORDS + led * LED::WORDS_PER_LED;
+    uint8_t white = 0;
+    if constexpr (LED::WHITE){
+        white = lane_byte(w[LED::W], lane);
+    }
+    return {lane_byte(w[LED::G], lane), lane_byte(w[LED::R], lane), lane_byte(w[LED::B], lane), white};
+}
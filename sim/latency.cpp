@@ -0,0 +1,91 @@
+// oreore_sim latency: push switch to first line latency over many presses
+//
+// Presses are spread pseudo-randomly (fixed seed) so they hit every phase of the line period
+// and of the WAIT polling. Hold time is 30 - 300ms, the DIP value is kept.
+// The firmware sees the release only when WAIT polls, so the simulator also measures from the
+// actual release edge (edge_to_first), which the device cannot timestamp without a rising edge IRQ.
+// Reports printed by the firmware on each press are discarded.
+//
+// $ oreore_sim latency [--dip N] [--presses N] [--cost-scale X]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "poi.h"
+#include "sim.h"
+#include "commands.h"
+#include "latency.h"
+
+int latency_sim(int argc, char ** argv){
+#if OREORE_LATENCY
+    int dip = 9;
+    uint32_t presses = 200;
+    double cost_scale = 0;
+    for(int i=0;i<argc;i++){
+        const std::string a = argv[i];
+        if(a == "--dip" && i + 1 < argc){
+            dip = atoi(argv[++i]);
+        }else if(a == "--presses" && i + 1 < argc){
+            presses = atoi(argv[++i]);
+        }else if(a == "--cost-scale" && i + 1 < argc){
+            cost_scale = atof(argv[++i]);
+        }else{
+            fprintf(stderr, "usage: oreore_sim latency [--dip N] [--presses N] [--cost-scale X]\n");
+            return 2;
+        }
+    }
+
+    sim_set_dip(dip);
+    sim_set_cost_scale(cost_scale);
+
+    uint32_t seed = 12345;
+    auto rnd = [&](uint32_t range){
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+    uint64_t t = 100000;
+    std::vector<uint64_t> releases;
+    for(uint32_t n=0;n<presses;n++){
+        const uint64_t hold = 30000 + rnd(270000);
+        sim_press(t, hold);
+        releases.push_back(t + hold);
+        t += hold + 100000 + rnd(400000);
+    }
+
+    // First RUN line after each release edge (WAIT lines are sent while psw_pressed is set)
+    tlm_histogram edge_to_first = {9};
+    size_t next_release = 0;
+    sim_set_output([&](const uint32_t *, uint32_t, uint64_t t_us){
+        if(next_release < releases.size() && t_us >= releases[next_release] && !psw_pressed){
+            edge_to_first.add(static_cast<uint32_t>(t_us - releases[next_release]));
+            next_release++;
+        }
+    });
+
+    fflush(stdout);
+    const int saved = dup(1);
+    const int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1);
+    poi_setup();
+    while(sim_now_us() < t){
+        poi_loop_once();
+    }
+    fflush(stdout);
+    dup2(saved, 1);
+    close(null);
+    close(saved);
+    sim_set_output(nullptr);
+
+    latency_dump();
+    printf("# latency edge_to_first samples=%lu p50=%lu p99=%lu max=%lu (simulator only)\n",
+        (unsigned long)edge_to_first.samples, (unsigned long)edge_to_first.percentile(50),
+        (unsigned long)edge_to_first.percentile(99), (unsigned long)edge_to_first.max);
+    return latency.presses == presses ? 0 : 1;
+#else
+    fprintf(stderr, "oreore_sim is built without OREORE_LATENCY\n");
+    return 1;
+#endif
+}
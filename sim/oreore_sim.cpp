@@ -0,0 +1,350 @@
+// oreore_sim: runs the firmware state machine and render path on a PC
+//
+// Usage
+// $ oreore_sim run [--dip N] [--time SEC] [--press MS[:HOLD_MS[:DIP]]]... [--cost-scale X] [--trace FILE] [--tap FILE]
+//                  [--replay FILE]
+//     Runs poi_setup / poi_loop_once on the virtual clock.
+//     --press switches images like the push switch (DIP is changed while the switch is down).
+//     --cost-scale charges host computation time x X to the virtual clock (default 0: free).
+//     --trace writes Chrome trace JSON (open with https://ui.perfetto.dev or chrome://tracing).
+//     --tap writes the raw USB CDC stream (OREORE_TAP frames, see tap_view.py).
+//     --replay uses per-line timing recorded on the device (OREORE_TELEMETRY CSV) as the cost model.
+// $ oreore_sim bench [--iterations N]
+//     Measures packing kernels on the host (CSV: kernel,image,ns_per_line), single line and batched (pack_lines)
+// $ oreore_sim pio [--dip N] [--lines N] [--edges FILE] [--led ws2812|apa102|sk6812]
+//     Runs ws2812_parallel (apa102_parallel) in the PIO emulator and verifies the waveform (see pio_verify.cpp)
+// $ oreore_sim digest [--check FILE | --update FILE]
+//     Golden digests of the packed bitstreams (see digest.cpp, sim/golden_digests.txt)
+// $ oreore_sim latency [--dip N] [--presses N] [--cost-scale X]
+//     Push switch to first line latency histograms (see latency.cpp)
+// $ oreore_sim preview [--dip N] [--out FILE] [--trajectory circle|linear] ...
+//     Long-exposure PNG of the swung poi (see preview.cpp)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "poi.h"
+#include "sim.h"
+#include "commands.h"
+#include "trace.h"
+
+namespace {
+
+struct run_options {
+    int dip = 9;                // symbol (31, all switches off, boots the self benchmark)
+    double time_s = 10;
+    double cost_scale = 0;
+    const char * trace = nullptr;
+    const char * tap = nullptr;
+    const char * replay = nullptr;
+};
+
+int usage(){
+    fprintf(stderr,
+        "usage: oreore_sim run [--dip N] [--time SEC] [--press MS[:HOLD_MS[:DIP]]]... [--cost-scale X] [--trace FILE] [--tap FILE]\n"
+        "                      [--replay FILE]\n"
+        "       oreore_sim bench [--iterations N]\n"
+        "       oreore_sim pio [--dip N] [--lines N] [--edges FILE] [--led ws2812|apa102|sk6812]\n"
+        "       oreore_sim digest [--check FILE | --update FILE]\n"
+        "       oreore_sim latency [--dip N] [--presses N] [--cost-scale X]\n"
+        "       oreore_sim preview [--dip N] [--out FILE] [--trajectory circle|linear] ...\n");
+    return 2;
+}
+
+// Parses "a:b:c" into up to 3 numbers
+int parse_press(const char * arg, uint64_t & at_ms, uint64_t & hold_ms, int & dip){
+    hold_ms = 50;
+    dip = -1;
+    char * end;
+    at_ms = strtoull(arg, &end, 10);
+    if(*end == ':'){
+        hold_ms = strtoull(end + 1, &end, 10);
+        if(*end == ':'){
+            dip = strtol(end + 1, &end, 10);
+        }
+    }
+    return *end == '\0';
+}
+
+// Reads records of telemetry_dump (line,image,idx,fetch_start,...,deadline[,events])
+bool load_replay(const char * path, std::vector<sim_replay_line> & lines){
+    FILE * f = fopen(path, "r");
+    if(!f){
+        perror(path);
+        return false;
+    }
+    const char * names[] = {"fetch_start", "fetch_end", "pack_end", "dma_start", "dma_done", "deadline", "events"};
+    const int NUM = sizeof(names) / sizeof(names[0]);
+    int column[NUM];
+    bool header = false;
+    char buf[512];
+    while(fgets(buf, sizeof(buf), f)){
+        std::vector<std::string> v;
+        std::string cell;
+        for(const char * p=buf;*p && *p != '\n' && *p != '\r';p++){
+            if(*p == ','){
+                v.push_back(cell);
+                cell.clear();
+            }else{
+                cell += *p;
+            }
+        }
+        v.push_back(cell);
+
+        if(v[0] == "line"){
+            // A new dump replaces the previous one
+            header = true;
+            lines.clear();
+            for(int i=0;i<NUM;i++){
+                column[i] = -1;
+                for(size_t c=0;c<v.size();c++){
+                    if(v[c] == names[i]){
+                        column[i] = static_cast<int>(c);
+                    }
+                }
+                if(column[i] < 0 && i < NUM - 1){
+                    fprintf(stderr, "%s: column %s not found\n", path, names[i]);
+                    fclose(f);
+                    return false;
+                }
+            }
+            continue;
+        }
+        if(!header || buf[0] == '#' || v.size() < 9){
+            continue;
+        }
+        uint32_t x[NUM] = {};
+        for(int i=0;i<NUM;i++){
+            if(column[i] >= 0 && column[i] < static_cast<int>(v.size())){
+                x[i] = static_cast<uint32_t>(strtoul(v[column[i]].c_str(), nullptr, 10));
+            }
+        }
+        if(x[3] == 0){
+            continue;   // not triggered
+        }
+        // 32bit timer wraps
+        auto diff = [](uint32_t a, uint32_t b){
+            const auto d = static_cast<int32_t>(a - b);
+            return d > 0 ? static_cast<uint32_t>(d) : 0u;
+        };
+        const auto ready = static_cast<int32_t>(x[2] - x[5]) > 0 ? x[2] : x[5];
+        lines.push_back({diff(x[1], x[0]), diff(x[2], x[1]), diff(x[3], ready), x[4] ? diff(x[4], x[3]) : 0, x[6]});
+    }
+    fclose(f);
+    if(lines.empty()){
+        fprintf(stderr, "%s: no telemetry records\n", path);
+        return false;
+    }
+    return true;
+}
+
+int run(int argc, char ** argv){
+    run_options opt;
+    for(int i=0;i<argc;i++){
+        const std::string a = argv[i];
+        const bool has_value = i + 1 < argc;
+        if(a == "--dip" && has_value){
+            opt.dip = atoi(argv[++i]);
+        }else if(a == "--time" && has_value){
+            opt.time_s = atof(argv[++i]);
+        }else if(a == "--cost-scale" && has_value){
+            opt.cost_scale = atof(argv[++i]);
+        }else if(a == "--trace" && has_value){
+            opt.trace = argv[++i];
+        }else if(a == "--tap" && has_value){
+            opt.tap = argv[++i];
+        }else if(a == "--replay" && has_value){
+            opt.replay = argv[++i];
+        }else if(a == "--press" && has_value){
+            uint64_t at_ms, hold_ms;
+            int dip;
+            if(!parse_press(argv[++i], at_ms, hold_ms, dip)){
+                return usage();
+            }
+            sim_press(at_ms * 1000, hold_ms * 1000, dip);
+        }else{
+            return usage();
+        }
+    }
+
+    sim_set_dip(opt.dip);
+    sim_set_cost_scale(opt.cost_scale);
+
+    if(opt.replay){
+        std::vector<sim_replay_line> lines;
+        if(!load_replay(opt.replay, lines)){
+            return 1;
+        }
+        sim_set_replay(lines);
+        fprintf(stderr, "%zu lines loaded from %s\n", lines.size(), opt.replay);
+    }
+
+    FILE * tap = nullptr;
+    if(opt.tap){
+        tap = fopen(opt.tap, "wb");
+        if(!tap){
+            perror(opt.tap);
+            return 1;
+        }
+        sim_set_cdc(tap);
+    }
+
+    // Line spans: from a DMA trigger to the next one
+    trace_writer trace;
+    uint64_t line_start = 0;
+    std::string line_name, line_args;
+    if(opt.trace){
+        sim_set_trace(&trace);
+        sim_set_output([&](const uint32_t *, uint32_t, uint64_t t_us){
+            if(!line_name.empty()){
+                trace.span(TRACE_LINE, line_name, line_start, t_us - line_start, line_args);
+            }
+            line_start = t_us;
+            // idx has been advanced for the next line already
+            line_name = psw_pressed ? "wait" : image_names[image_id(poi.info)];
+            line_args = "\"next_idx\":" + std::to_string(poi.idx) + ",\"pass\":" + std::to_string(poi.pass);
+        });
+    }
+
+    const auto wall0 = std::chrono::steady_clock::now();
+    poi_setup();
+    const uint64_t end_us = static_cast<uint64_t>(opt.time_s * 1e6);
+    while(sim_now_us() < end_us){
+        poi_loop_once();
+    }
+    const auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+    if(tap){
+        sim_set_cdc(nullptr);
+        fclose(tap);
+    }
+    if(opt.trace){
+        sim_set_trace(nullptr);
+        sim_set_output(nullptr);
+        if(!trace.write(opt.trace)){
+            perror(opt.trace);
+            return 1;
+        }
+        fprintf(stderr, "%zu trace events written to %s\n", trace.size(), opt.trace);
+    }
+
+    const auto & st = sim_get_stats();
+    printf("# sim virtual=%.3fs wall=%.3fs speed=%.0fx lines=%llu dma_overlaps=%llu replayed=%llu image=%s\n",
+        sim_now_us() / 1e6, wall, wall > 0 ? sim_now_us() / 1e6 / wall : 0.0,
+        (unsigned long long)st.lines, (unsigned long long)st.dma_overlaps, (unsigned long long)st.replayed,
+        image_names[image_id(poi.info)]);
+    return 0;
+}
+
+int bench(int argc, char ** argv){
+    uint32_t iterations = 2000;
+    for(int i=0;i<argc;i++){
+        if(strcmp(argv[i], "--iterations") == 0 && i + 1 < argc){
+            iterations = atoi(argv[++i]);
+        }else{
+            return usage();
+        }
+    }
+
+    static uint32_t packet[PACKET_WORDS];
+    uint32_t sink = 0;
+    auto measure = [&](const char * kernel, const image_info * info, auto && pack){
+        for(uint32_t n=0;n<iterations/10+1;n++){  // warm up
+            pack(static_cast<int32_t>(n % info->height));
+        }
+        const auto t0 = std::chrono::steady_clock::now();
+        for(uint32_t n=0;n<iterations;n++){
+            const auto y = static_cast<int32_t>(n % info->height);
+            pack(y);
+            sink += packet[n % PACKET_WORDS];
+        }
+        const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        printf("%s,%s,%.1f\n", kernel, image_names[image_id(info)], ns / iterations);
+    };
+
+    printf("kernel,image,ns_per_line\n");
+    for(uint32_t i=0;i<num_images;i++){
+        const auto info = image_table[i];
+        measure("pack_parallel", info, [&](int32_t y){
+            pack_parallel(packet, extractline(info, y));
+        });
+        measure("pack_parallel_sft", info, [&](int32_t y){
+            pack_parallel_sft(packet, extractline(info, y), extractline(info, y+1), extractline(info, y+2), false);
+        });
+        measure("pack_parallel_sft_reverse", info, [&](int32_t y){
+            pack_parallel_sft(packet, extractline(info, y), extractline(info, y+1), extractline(info, y+2), true);
+        });
+        static uint8_t err[9*LENGTH];
+        measure("pack_parallel_dither", info, [&](int32_t y){
+            const auto line = extractline(info, y);
+            const uint8_t * const src[3] = {line, line, line};
+            pack_parallel_dither(packet, src, 100, err);
+        });
+        // As RUN after the first line: the previous line was packed from the rows of y - 1 (looped)
+        measure("pack_parallel_dirty", info, [&](int32_t y){
+            const auto line = extractline(info, y);
+            const auto prev_line = extractline(info, y > 0 ? y - 1 : info->height - 1);
+            const uint8_t * const src[3] = {line, line, line};
+            const uint8_t * const prev[3] = {prev_line, prev_line, prev_line};
+            pack_parallel_dirty(packet, prev, src);
+        });
+        measure("pack_parallel_dirty_sft", info, [&](int32_t y){
+            const uint8_t * const src[3] = {extractline(info, y+2), extractline(info, y+1), extractline(info, y)};
+            const uint8_t * const prev[3] = {extractline(info, y+1), extractline(info, y), extractline(info, y-1)};
+            pack_parallel_dirty(packet, prev, src);
+        });
+
+        // Batched: the whole image per call (ns per line)
+        std::vector<const uint8_t *> rows;
+        for(uint32_t y=0;y<info->height+2;y++){
+            rows.push_back(extractline(info, y));
+        }
+        std::vector<uint32_t> packed(info->height * PACKET_WORDS);
+        auto out = reinterpret_cast<uint32_t (*)[PACKET_WORDS]>(packed.data());
+        auto measure_batch = [&](const char * kernel, auto && pack){
+            const uint32_t calls = iterations / info->height + 1;
+            pack();     // warm up
+            const auto t0 = std::chrono::steady_clock::now();
+            for(uint32_t n=0;n<calls;n++){
+                pack();
+                sink += packed[n % packed.size()];
+            }
+            const auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+            printf("%s,%s,%.1f\n", kernel, image_names[i], ns / calls / info->height);
+        };
+        measure_batch("pack_lines", [&](){
+            pack_lines(rows.data(), info->height, out);
+        });
+        measure_batch("pack_lines_sft", [&](){
+            pack_lines_sft(rows.data(), info->height, out, false);
+        });
+    }
+    return sink == 0x12345678 ? 1 : 0;  // keep results alive
+}
+
+}
+
+int main(int argc, char ** argv){
+    if(argc >= 2 && strcmp(argv[1], "bench") == 0){
+        return bench(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && strcmp(argv[1], "pio") == 0){
+        return pio_verify(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && strcmp(argv[1], "digest") == 0){
+        return digest(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && strcmp(argv[1], "latency") == 0){
+        return latency_sim(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && strcmp(argv[1], "preview") == 0){
+        return preview(argc - 2, argv + 2);
+    }
+    if(argc >= 2 && strcmp(argv[1], "run") == 0){
+        return run(argc - 2, argv + 2);
+    }
+    return run(argc - 1, argv + 1);
+}
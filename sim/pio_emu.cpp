@@ -0,0 +1,282 @@
+// Cycle-accurate emulator of a PIO block (see pio_emu.h)
+
+#include "pio_emu.h"
+
+namespace {
+
+uint32_t bitreverse(uint32_t v){
+    uint32_t r = 0;
+    for(int i=0;i<32;i++){
+        r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+}
+
+uint32_t rotate_right(uint32_t v, uint32_t n){
+    n %= 32;
+    return n ? (v >> n) | (v << (32 - n)) : v;
+}
+
+uint32_t mask(uint32_t count){
+    return count >= 32 ? 0xffffffff : (1u << count) - 1;
+}
+
+}
+
+uint32_t pio_emu::add_program(const uint16_t * program, uint32_t length, int origin){
+    const uint32_t m = mask(length);
+    int offset = origin;
+    if(offset < 0){
+        // The SDK allocates from the top of instruction memory
+        for(offset = 32 - length; offset >= 0; offset--){
+            if(!(used & (m << offset))){
+                break;
+            }
+        }
+        if(offset < 0){
+            errors.push_back("instruction memory full");
+            return 0;
+        }
+    }
+    for(uint32_t i=0;i<length;i++){
+        uint16_t op = program[i];
+        if((op >> 13) == 0){
+            // JMP: relocate target address
+            op = (op & ~0x1f) | (((op & 0x1f) + offset) & 0x1f);
+        }
+        instr[offset + i] = op;
+    }
+    used |= m << offset;
+    return offset;
+}
+
+void pio_emu::write_pins(uint32_t base, uint32_t count, uint32_t value){
+    for(uint32_t i=0;i<count;i++){
+        const uint32_t pin = (base + i) % 32;
+        pins = (pins & ~(1u << pin)) | (((value >> i) & 1) << pin);
+    }
+}
+
+void pio_emu::write_pindirs(uint32_t base, uint32_t count, uint32_t value){
+    for(uint32_t i=0;i<count;i++){
+        const uint32_t pin = (base + i) % 32;
+        pindirs = (pindirs & ~(1u << pin)) | (((value >> i) & 1) << pin);
+    }
+}
+
+// Executes one instruction. Returns false if it stalls.
+bool pio_emu::execute(pio_emu_sm & s, uint16_t op){
+    const auto & c = s.cfg;
+    const uint32_t kind = op >> 13;
+    const uint32_t arg1 = (op >> 5) & 0x7;
+    const uint32_t arg2 = op & 0x1f;
+    uint32_t next_pc = s.pc == c.wrap ? c.wrap_target : (s.pc + 1) % 32;
+
+    auto source = [&](uint32_t src) -> uint32_t {
+        switch(src){
+            case 0: return rotate_right(pins, c.in_base);
+            case 1: return s.x;
+            case 2: return s.y;
+            case 3: return 0;
+            case 5: return s.tx_fifo.empty() ? 0xffffffff : 0; // STATUS (TX empty, default config)
+            case 6: return s.isr;
+            case 7: return s.osr;
+        }
+        errors.push_back("unsupported source");
+        return 0;
+    };
+
+    switch(kind){
+    case 0: { // JMP
+        bool cond = false;
+        switch(arg1){
+            case 0: cond = true; break;
+            case 1: cond = s.x == 0; break;
+            case 2: cond = s.x != 0; s.x--; break;
+            case 3: cond = s.y == 0; break;
+            case 4: cond = s.y != 0; s.y--; break;
+            case 5: cond = s.x != s.y; break;
+            case 6: cond = false; errors.push_back("jmp pin is not supported"); break;
+            case 7: cond = s.osr_count < c.pull_threshold; break;
+        }
+        if(cond){
+            next_pc = arg2;
+        }
+        break;
+    }
+    case 2: { // IN
+        const uint32_t n = arg2 ? arg2 : 32;
+        const uint32_t v = source(arg1) & mask(n);
+        if(c.in_shift_right){
+            s.isr = (n == 32 ? 0 : s.isr >> n) | (v << (32 - n));
+        }else{
+            s.isr = (n == 32 ? 0 : s.isr << n) | v;
+        }
+        s.isr_count = s.isr_count + n > 32 ? 32 : s.isr_count + n;
+        if(c.autopush && s.isr_count >= c.push_threshold){
+            s.rx_fifo.push_back(s.isr);
+            s.isr = 0;
+            s.isr_count = 0;
+        }
+        break;
+    }
+    case 3: { // OUT
+        if(c.autopull && s.osr_count >= c.pull_threshold){
+            if(s.tx_fifo.empty()){
+                return false;
+            }
+            s.osr = s.tx_fifo.front();
+            s.tx_fifo.pop_front();
+            s.osr_count = 0;
+        }
+        const uint32_t n = arg2 ? arg2 : 32;
+        uint32_t v;
+        if(c.out_shift_right){
+            v = s.osr & mask(n);
+            s.osr = n == 32 ? 0 : s.osr >> n;
+        }else{
+            v = n == 32 ? s.osr : s.osr >> (32 - n);
+            s.osr = n == 32 ? 0 : s.osr << n;
+        }
+        s.osr_count = s.osr_count + n > 32 ? 32 : s.osr_count + n;
+        switch(arg1){
+            case 0: write_pins(c.out_base, n < c.out_count ? n : c.out_count, v); break;
+            case 1: s.x = v; break;
+            case 2: s.y = v; break;
+            case 3: break;
+            case 4: write_pindirs(c.out_base, n < c.out_count ? n : c.out_count, v); break;
+            case 5: next_pc = v & 0x1f; break;
+            case 6: s.isr = v; s.isr_count = n; break;
+            default: errors.push_back("out exec is not supported"); break;
+        }
+        break;
+    }
+    case 4: { // PUSH / PULL
+        const bool pull = op & 0x80;
+        const bool if_flag = op & 0x40;
+        const bool block = op & 0x20;
+        if(pull){
+            if(if_flag && s.osr_count < c.pull_threshold){
+                break;
+            }
+            if(s.tx_fifo.empty()){
+                if(block){
+                    return false;
+                }
+                s.osr = s.x;
+            }else{
+                s.osr = s.tx_fifo.front();
+                s.tx_fifo.pop_front();
+            }
+            s.osr_count = 0;
+        }else{
+            if(if_flag && s.isr_count < c.push_threshold){
+                break;
+            }
+            s.rx_fifo.push_back(s.isr);
+            s.isr = 0;
+            s.isr_count = 0;
+        }
+        break;
+    }
+    case 5: { // MOV
+        const uint32_t mov_op = (op >> 3) & 0x3;
+        uint32_t v = source(op & 0x7);
+        if(mov_op == 1){
+            v = ~v;
+        }else if(mov_op == 2){
+            v = bitreverse(v);
+        }
+        switch(arg1){
+            case 0: write_pins(c.out_base, c.out_count, v); break;
+            case 1: s.x = v; break;
+            case 2: s.y = v; break;
+            case 3: write_pindirs(c.out_base, c.out_count, v); break;
+            case 5: next_pc = v & 0x1f; break;
+            case 6: s.isr = v; s.isr_count = 0; break;
+            case 7: s.osr = v; s.osr_count = 0; break;
+            default: errors.push_back("mov exec is not supported"); break;
+        }
+        break;
+    }
+    case 6: // IRQ (no other agents are emulated)
+        break;
+    case 7: { // SET
+        switch(arg1){
+            case 0: write_pins(c.set_base, c.set_count, arg2); break;
+            case 1: s.x = arg2; break;
+            case 2: s.y = arg2; break;
+            case 4: write_pindirs(c.set_base, c.set_count, arg2); break;
+            default: errors.push_back("unsupported set destination"); break;
+        }
+        break;
+    }
+    default:
+        errors.push_back("wait is not supported");
+        break;
+    }
+
+    s.pc = next_pc;
+    return true;
+}
+
+uint32_t pio_emu::step(pio_emu_sm & s){
+    const auto & c = s.cfg;
+
+    // Fractional divider: the state machine runs once every (int + frac / 256) system clocks on average
+    s.frac_acc += c.clkdiv_frac;
+    const uint32_t cycles = (c.clkdiv_int ? c.clkdiv_int : 65536) + (s.frac_acc >> 8);
+    s.frac_acc &= 0xff;
+
+    if(s.delay > 0){
+        s.delay--;
+        return cycles;
+    }
+
+    const uint16_t op = instr[s.pc];
+    const uint32_t field = (op >> 8) & 0x1f;
+    const uint32_t side_bits = c.sideset_count;
+    const uint32_t delay_bits = 5 - side_bits;
+    const uint32_t before = pins;
+
+    // Side-set takes place even if the instruction stalls
+    if(side_bits > 0){
+        const bool enable = !c.sideset_opt || (field & 0x10);
+        const uint32_t value_bits = c.sideset_opt ? side_bits - 1 : side_bits;
+        const uint32_t value = (field >> delay_bits) & mask(value_bits);
+        if(enable && !s.stalled){
+            if(c.sideset_pindirs){
+                write_pindirs(c.sideset_base, value_bits, value);
+            }else{
+                write_pins(c.sideset_base, value_bits, value);
+            }
+        }
+    }
+
+    s.stalled = !execute(s, op);
+    if(!s.stalled){
+        s.delay = field & mask(delay_bits);
+    }
+    if(pins != before){
+        edges.push_back({sys_cycle, pins});
+    }
+    return cycles;
+}
+
+void pio_emu::run(uint32_t index, uint64_t max_sys_cycles){
+    auto & s = sm[index];
+    const uint64_t end = sys_cycle + max_sys_cycles;
+    while(s.enabled && sys_cycle < end){
+        const bool idle = s.stalled && s.tx_fifo.empty() && s.delay == 0;
+        if(idle){
+            return;
+        }
+        sys_cycle += step(s);
+    }
+}
+
+void pio_emu::idle_until(uint64_t cycle){
+    if(sys_cycle < cycle){
+        sys_cycle = cycle;
+    }
+}
@@ -0,0 +1,91 @@
+// Cycle-accurate emulator of a PIO block (host side)
+//
+// Supports JMP, IN, OUT, PUSH, PULL, MOV, SET (and IRQ as NOP), side-set, delays, wrap,
+// autopull and the fractional clock divider. Every change of the GPIO outputs is recorded
+// with the system clock cycle, so waveforms can be checked against LED timing.
+// Programs are loaded through the pico SDK API (sim/pio_shim), which is what the
+// pioasm-generated ws2812.pio.h calls.
+
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct pio_sm_config {
+    uint32_t clkdiv_int = 1;
+    uint32_t clkdiv_frac = 0;       // 1/256
+    uint32_t wrap_target = 0;
+    uint32_t wrap = 31;
+    uint32_t sideset_count = 0;     // including the enable bit
+    bool sideset_opt = false;
+    bool sideset_pindirs = false;
+    uint32_t sideset_base = 0;
+    uint32_t out_base = 0;
+    uint32_t out_count = 32;
+    uint32_t set_base = 0;
+    uint32_t set_count = 5;
+    uint32_t in_base = 0;
+    bool out_shift_right = true;
+    bool autopull = false;
+    uint32_t pull_threshold = 32;
+    bool in_shift_right = true;
+    bool autopush = false;
+    uint32_t push_threshold = 32;
+};
+
+struct pio_emu_edge {
+    uint64_t sys_cycle;
+    uint32_t pins;
+};
+
+struct pio_emu_sm {
+    pio_sm_config cfg;
+    bool enabled = false;
+    uint32_t pc = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t osr = 0;
+    uint32_t isr = 0;
+    uint32_t osr_count = 32;        // 32: empty
+    uint32_t isr_count = 0;
+    uint32_t delay = 0;
+    uint32_t frac_acc = 0;
+    bool stalled = false;
+    std::deque<uint32_t> tx_fifo;
+    std::deque<uint32_t> rx_fifo;
+};
+
+struct pio_emu {
+    static const uint32_t NUM_SM = 4;
+
+    uint16_t instr[32] = {};
+    uint32_t used = 0;              // instruction memory bitmap
+    pio_emu_sm sm[NUM_SM];
+    uint32_t claimed = 0;
+    uint32_t pins = 0;
+    uint32_t pindirs = 0;
+    uint64_t sys_cycle = 0;
+    uint32_t sys_hz = 150000000;
+    std::vector<pio_emu_edge> edges;
+    std::vector<std::string> errors;
+
+    uint32_t add_program(const uint16_t * program, uint32_t length, int origin);
+
+    // Runs sm until it stalls with an empty TX FIFO, or max_sys_cycles elapse
+    void run(uint32_t index, uint64_t max_sys_cycles);
+
+    // Lets time pass while all state machines are stalled
+    void idle_until(uint64_t cycle);
+
+    double cycle_ns() const {
+        return 1e9 / sys_hz;
+    }
+
+private:
+    uint32_t step(pio_emu_sm & s);      // returns sys cycles consumed
+    bool execute(pio_emu_sm & s, uint16_t op);
+    void write_pins(uint32_t base, uint32_t count, uint32_t value);
+    void write_pindirs(uint32_t base, uint32_t count, uint32_t value);
+};
@@ -0,0 +1,14 @@
+// Host replacement of the pico SDK hardware/clocks.h (see pio.h)
+
+#pragma once
+
+#include <stdint.h>
+
+enum clock_num {
+    clk_sys = 5
+};
+
+// RP2350 default system clock
+static inline uint32_t clock_get_hz(enum clock_num){
+    return 150000000;
+}
@@ -0,0 +1,94 @@
+// Host replacement of the pico SDK hardware/pio.h
+//
+// Provides the subset of the API which pioasm-generated headers (ws2812.pio.h) use,
+// and maps it onto the PIO emulator (pio_emu.h).
+
+#pragma once
+
+#include <stdint.h>
+#include "pio_emu.h"
+
+typedef unsigned int uint;
+typedef pio_emu * PIO;
+
+extern pio_emu pio0_emu;
+#define pio0 (&pio0_emu)
+
+#ifndef PICO_PIO_VERSION
+#define PICO_PIO_VERSION 0
+#endif
+
+struct pio_program {
+    const uint16_t * instructions;
+    uint8_t length;
+    int8_t origin;
+    uint8_t pio_version;
+};
+typedef struct pio_program pio_program_t;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2
+};
+
+static inline pio_sm_config pio_get_default_sm_config(){
+    return pio_sm_config();
+}
+
+static inline void sm_config_set_wrap(pio_sm_config * c, uint wrap_target, uint wrap){
+    c->wrap_target = wrap_target;
+    c->wrap = wrap;
+}
+
+static inline void sm_config_set_sideset(pio_sm_config * c, uint bit_count, bool optional, bool pindirs){
+    c->sideset_count = bit_count;
+    c->sideset_opt = optional;
+    c->sideset_pindirs = pindirs;
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config * c, uint sideset_base){
+    c->sideset_base = sideset_base;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config * c, uint out_base, uint out_count){
+    c->out_base = out_base;
+    c->out_count = out_count;
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config * c, uint set_base, uint set_count){
+    c->set_base = set_base;
+    c->set_count = set_count;
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config * c, uint in_base){
+    c->in_base = in_base;
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config * c, bool shift_right, bool autopull, uint pull_threshold){
+    c->out_shift_right = shift_right;
+    c->autopull = autopull;
+    c->pull_threshold = pull_threshold ? pull_threshold : 32;
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config * c, bool shift_right, bool autopush, uint push_threshold){
+    c->in_shift_right = shift_right;
+    c->autopush = autopush;
+    c->push_threshold = push_threshold ? push_threshold : 32;
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *, enum pio_fifo_join){
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config * c, float div){
+    c->clkdiv_int = static_cast<uint32_t>(div);
+    c->clkdiv_frac = static_cast<uint32_t>((div - c->clkdiv_int) * 256);
+}
+
+uint pio_add_program(PIO pio, const pio_program_t * program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
@@ -0,0 +1,47 @@
+// Host replacement of the pico SDK PIO functions (see hardware/pio.h)
+
+#include "hardware/pio.h"
+
+pio_emu pio0_emu;
+
+uint pio_add_program(PIO pio, const pio_program_t * program){
+    return pio->add_program(program->instructions, program->length, program->origin);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required){
+    for(uint32_t i=0;i<pio_emu::NUM_SM;i++){
+        if(!(pio->claimed & (1u << i))){
+            pio->claimed |= 1u << i;
+            return i;
+        }
+    }
+    if(required){
+        pio->errors.push_back("no free state machine");
+    }
+    return -1;
+}
+
+void pio_gpio_init(PIO, uint){
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint, uint pin_base, uint pin_count, bool is_out){
+    for(uint i=0;i<pin_count;i++){
+        const uint32_t bit = 1u << ((pin_base + i) % 32);
+        pio->pindirs = is_out ? (pio->pindirs | bit) : (pio->pindirs & ~bit);
+    }
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config * config){
+    auto & s = pio->sm[sm];
+    s = pio_emu_sm();
+    s.cfg = *config;
+    s.pc = initial_pc;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled){
+    pio->sm[sm].enabled = enabled;
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data){
+    pio->sm[sm].tx_fifo.push_back(data);
+}
@@ -0,0 +1,494 @@
+// oreore_sim pio: runs ws2812_parallel in the PIO emulator with the words DMA would send
+//
+// - Decodes per-pin waveforms back into GRB values and compares them with the packet
+// - Checks bit timing against WS2812B tolerances and the reset time between lines
+// - Optionally writes the edge timeline (--edges FILE, CSV)
+//
+// --led sk6812: runs ws2812_parallel with lines packed by pack_parallel<led_sk6812> / pack_parallel_sft
+// from the image of the DIP switches, with the same timing checks, and compares the GRBW values of
+// every LED with the source pixels (white extracted as min(R, G, B))
+//
+// --led apa102: runs apa102_parallel with lines packed by pack_parallel<led_apa102> / pack_parallel_sft
+// from the image of the DIP switches (the firmware loop of the simulator drives WS2812)
+// - Samples the data lanes at every rising clock edge and decodes APA102 / SK9822 frames
+//   (start frame, LED headers, BGR, end frame) back into the source pixels
+// - Checks the clock rate and data setup / hold around the rising edges
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "poi.h"
+#include "sim.h"
+#include "lanes.h"
+#include "commands.h"
+#include "ws2812.pio.h"
+
+namespace {
+
+// WS2812B datasheet [ns]
+const double T0H_ns = 400;
+const double T1H_ns = 800;
+const double T0L_ns = 850;
+const double T1L_ns = 450;
+const double TOLERANCE_ns = 150;
+const double RESET_ns = 50000;          // original WS2812B
+const double RESET_V5_ns = 280000;      // WS2812B V5 and later
+
+struct range {
+    double min = 1e18;
+    double max = 0;
+    void add(double v){
+        min = std::min(min, v);
+        max = std::max(max, v);
+    }
+};
+
+struct verify_result {
+    uint64_t frames = 0;
+    uint64_t bits = 0;
+    uint64_t timing_errors = 0;
+    uint64_t bit_count_errors = 0;
+    uint64_t value_errors = 0;      // LEDs
+    uint64_t reset_errors = 0;
+    uint64_t short_resets = 0;          // shorter than RESET_V5_ns
+    range t0h, t1h, t0l, t1l, reset;
+};
+
+bool within(double v, double nominal){
+    return nominal - TOLERANCE_ns <= v && v <= nominal + TOLERANCE_ns;
+}
+
+// Decodes every lane of a line of `count` words (edges from `first` on) into bytes[lane], and checks
+// the bit timing and the reset time since the previous line. bytes[lane] stays empty on a wrong bit count.
+void decode_ws2812(const pio_emu & emu, const size_t first, const uint32_t count, const uint pin_base, const uint pin_count,
+    verify_result & res, double & last_fall_ns, std::vector<uint8_t> (&bytes)[4]){
+    double frame_first_rise = -1;
+    double frame_last_fall = -1;
+    for(uint lane=0;lane<pin_count;lane++){
+        const uint32_t bit = 1u << (pin_base + lane);
+        std::vector<double> rises, falls;
+        bool level = first > 0 ? (emu.edges[first - 1].pins & bit) : false;
+        for(size_t e=first;e<emu.edges.size();e++){
+            const bool v = emu.edges[e].pins & bit;
+            if(v != level){
+                (v ? rises : falls).push_back(emu.edges[e].sys_cycle * emu.cycle_ns());
+                level = v;
+            }
+        }
+        if(rises.size() != falls.size() || rises.size() != count * 8){
+            res.bit_count_errors++;
+            continue;
+        }
+        if(frame_first_rise < 0 || rises.front() < frame_first_rise){
+            frame_first_rise = rises.front();
+        }
+        frame_last_fall = std::max(frame_last_fall, falls.back());
+
+        bytes[lane].assign(count, 0);
+        for(size_t b=0;b<rises.size();b++){
+            const double high = falls[b] - rises[b];
+            const bool one = high > (T0H_ns + T1H_ns) / 2;
+            bytes[lane][b / 8] = (bytes[lane][b / 8] << 1) | (one ? 1 : 0);
+            res.bits++;
+
+            bool ok = within(high, one ? T1H_ns : T0H_ns);
+            (one ? res.t1h : res.t0h).add(high);
+            if(b + 1 < rises.size()){
+                const double low = rises[b + 1] - falls[b];
+                (one ? res.t1l : res.t0l).add(low);
+                ok = ok && within(low, one ? T1L_ns : T0L_ns);
+            }
+            if(!ok){
+                res.timing_errors++;
+            }
+        }
+    }
+
+    if(last_fall_ns >= 0 && frame_first_rise >= 0){
+        const double gap = frame_first_rise - last_fall_ns;
+        res.reset.add(gap);
+        if(gap < RESET_ns){
+            res.reset_errors++;
+        }else if(gap < RESET_V5_ns){
+            res.short_resets++;
+        }
+    }
+    if(frame_last_fall >= 0){
+        last_fall_ns = frame_last_fall;
+    }
+}
+
+bool report_ws2812(const verify_result & res, const pio_emu & emu){
+    printf("T0H %.0f-%.0f ns (%.0f+-%.0f)\n", res.t0h.min, res.t0h.max, T0H_ns, TOLERANCE_ns);
+    printf("T1H %.0f-%.0f ns (%.0f+-%.0f)\n", res.t1h.min, res.t1h.max, T1H_ns, TOLERANCE_ns);
+    printf("T0L %.0f-%.0f ns (%.0f+-%.0f)\n", res.t0l.min, res.t0l.max, T0L_ns, TOLERANCE_ns);
+    printf("T1L %.0f-%.0f ns (%.0f+-%.0f)\n", res.t1l.min, res.t1l.max, T1L_ns, TOLERANCE_ns);
+    printf("reset %.1f-%.1f us (>= %.0f us, V5: >= %.0f us)\n", res.reset.min / 1000, res.reset.max / 1000,
+        RESET_ns / 1000, RESET_V5_ns / 1000);
+    printf("timing_errors=%llu bit_count_errors=%llu value_errors=%llu reset_errors=%llu short_resets(V5)=%llu\n",
+        (unsigned long long)res.timing_errors, (unsigned long long)res.bit_count_errors,
+        (unsigned long long)res.value_errors, (unsigned long long)res.reset_errors,
+        (unsigned long long)res.short_resets);
+    for(const auto & e : emu.errors){
+        printf("emulator: %s\n", e.c_str());
+    }
+
+    const bool ok = res.timing_errors == 0 && res.bit_count_errors == 0 && res.value_errors == 0
+        && res.reset_errors == 0 && emu.errors.empty();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+// Clocked LEDs sample data on the rising edge, data changes on the falling edge (half a clock apart)
+const double SETUP_MIN_ns = 30;
+const double HOLD_MIN_ns = 30;
+const uint CLOCK_PIN = 5;           // APA102_CLOCK_PIN of oreore_poi.cpp
+
+struct clocked_result {
+    uint64_t frames = 0;
+    uint64_t clocks = 0;
+    uint64_t clock_count_errors = 0;    // frames
+    uint64_t frame_errors = 0;          // start / end frame or LED header (lanes)
+    uint64_t value_errors = 0;          // LEDs
+    uint64_t timing_errors = 0;
+    range period, high, setup, hold;
+};
+
+void write_edges(const char * edges_file, const pio_emu & emu, const uint pin_base, const uint pin_count, const int clock_pin){
+    FILE * f = fopen(edges_file, "w");
+    if(!f){
+        perror(edges_file);
+        return;
+    }
+    fprintf(f, "time_ns");
+    for(uint lane=0;lane<pin_count;lane++){
+        fprintf(f, ",gpio%u", pin_base + lane);
+    }
+    if(clock_pin >= 0){
+        fprintf(f, ",gpio%d", clock_pin);
+    }
+    fprintf(f, "\n");
+    for(const auto & e : emu.edges){
+        fprintf(f, "%.1f", e.sys_cycle * emu.cycle_ns());
+        for(uint lane=0;lane<pin_count;lane++){
+            fprintf(f, ",%u", (e.pins >> (pin_base + lane)) & 1);
+        }
+        if(clock_pin >= 0){
+            fprintf(f, ",%u", (e.pins >> clock_pin) & 1);
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+}
+
+int pio_verify_sk6812(const int dip, const uint64_t lines, const char * edges_file){
+    typedef led_sk6812 LED;
+    const uint pin_base = 26;
+    const uint pin_count = 4;
+    const auto offset = pio_add_program(pio0, &ws2812_parallel_program);
+    const auto sm = pio_claim_unused_sm(pio0, true);
+    ws2812_parallel_program_init(pio0, sm, offset, pin_base, pin_count, LED::BIT_HZ);
+    auto & emu = *pio0;
+
+    sim_set_dip(dip);
+    const auto info = loadImage();
+    const bool reverse = dip & 0x10;
+    // Lines at the period of the image scaled to the protocol, at least a line and a V5 reset apart
+    const double line_us = packet_words<LED>() * 8 * 1e6 / LED::BIT_HZ;
+    const uint64_t period_us = std::max<uint64_t>(info->period_us * LED::PERIOD_us / DEFAULT_PERIOD_us,
+        line_us + RESET_V5_ns / 1000 + 1);
+
+    static uint32_t packet[packet_words<LED>()];
+    pack_frame<LED>(packet);
+
+    verify_result res;
+    double last_fall_ns = -1;
+    int32_t idx = info->multiline ? -2 : 0;
+    for(uint64_t n=0;n<lines;n++, idx++){
+        const uint8_t * src[3];
+        if(info->multiline){
+            const auto line0 = extractline(info, idx);
+            const auto line1 = extractline(info, idx+1);
+            const auto line2 = extractline(info, idx+2);
+            pack_parallel_sft<LED>(packet, line0, line1, line2, reverse);
+            src[0] = reverse ? line0 : line2;
+            src[1] = line1;
+            src[2] = reverse ? line2 : line0;
+        }else{
+            src[0] = src[1] = src[2] = extractline(info, idx);
+            pack_parallel<LED>(packet, src[0]);
+        }
+
+        emu.idle_until(n * period_us * (emu.sys_hz / 1000000));
+        const size_t first = emu.edges.size();
+        for(const auto w : packet){
+            pio_sm_put(pio0, sm, w);
+        }
+        emu.run(sm, 1000ull * emu.sys_hz);
+        res.frames++;
+
+        std::vector<uint8_t> bytes[4];
+        decode_ws2812(emu, first, packet_words<LED>(), pin_base, pin_count, res, last_fall_ns, bytes);
+        for(uint lane=0;lane<3;lane++){
+            if(bytes[lane].empty()){
+                continue;
+            }
+            for(uint32_t i=0;i<LENGTH;i++){
+                // LED i of lane l is src[l][i*9 + 3*l] (R, G, B), sent as G, R, B, W
+                const uint8_t * rgb = &src[lane][i*9 + 3*lane];
+                const uint8_t m = std::min({rgb[0], rgb[1], rgb[2]});
+                const uint8_t w = std::min<uint32_t>(255, m * LED::WHITE_GAIN / 256);
+                const uint8_t * b = &bytes[lane][i * 4];
+                if(b[0] != rgb[1] - m || b[1] != rgb[0] - m || b[2] != rgb[2] - m || b[3] != w){
+                    res.value_errors++;
+                }
+            }
+        }
+    }
+
+    if(edges_file){
+        write_edges(edges_file, emu, pin_base, pin_count, -1);
+    }
+
+    printf("# pio sk6812 frames=%llu bits=%llu image=%s words=%lu line=%.1fus period=%lluus idle=%.1fus\n",
+        (unsigned long long)res.frames, (unsigned long long)res.bits, image_names[image_id(info)],
+        (unsigned long)packet_words<LED>(), line_us, (unsigned long long)period_us, period_us - line_us);
+    return report_ws2812(res, emu) ? 0 : 1;
+}
+
+int pio_verify_apa102(const int dip, const uint64_t lines, const char * edges_file){
+    typedef led_apa102 LED;
+    const uint pin_base = 26;
+    const uint pin_count = 4;
+    const auto offset = pio_add_program(pio0, &apa102_parallel_program);
+    const auto sm = pio_claim_unused_sm(pio0, true);
+    apa102_parallel_program_init(pio0, sm, offset, pin_base, pin_count, CLOCK_PIN, LED::BIT_HZ);
+    auto & emu = *pio0;
+
+    sim_set_dip(dip);
+    const auto info = loadImage();
+    const bool reverse = dip & 0x10;
+    const uint32_t clock = 1u << CLOCK_PIN;
+    const uint32_t data = 0xfu << pin_base;
+    // Lines at the period of the image scaled to the protocol, no reset time (the clock latches the data)
+    const double line_us = packet_words<LED>() * 8 * 1e6 / LED::BIT_HZ;
+    const uint64_t period_us = info->period_us * LED::PERIOD_us / DEFAULT_PERIOD_us;
+    if(line_us >= period_us){
+        printf("pio apa102: a line takes %.1fus, longer than the period %lluus\n", line_us,
+            (unsigned long long)period_us);
+        return 1;
+    }
+
+    static uint32_t packet[packet_words<LED>()];
+    pack_frame<LED>(packet);
+
+    clocked_result res;
+    int32_t idx = info->multiline ? -2 : 0;
+    for(uint64_t n=0;n<lines;n++, idx++){
+        const uint8_t * src[3];
+        if(info->multiline){
+            const auto line0 = extractline(info, idx);
+            const auto line1 = extractline(info, idx+1);
+            const auto line2 = extractline(info, idx+2);
+            pack_parallel_sft<LED>(packet, line0, line1, line2, reverse);
+            src[0] = reverse ? line0 : line2;
+            src[1] = line1;
+            src[2] = reverse ? line2 : line0;
+        }else{
+            src[0] = src[1] = src[2] = extractline(info, idx);
+            pack_parallel<LED>(packet, src[0]);
+        }
+
+        emu.idle_until(n * period_us * (emu.sys_hz / 1000000));
+        const size_t first = emu.edges.size();
+        for(const auto w : packet){
+            pio_sm_put(pio0, sm, w);
+        }
+        emu.run(sm, 1000ull * emu.sys_hz);
+        res.frames++;
+
+        // Serial bits of every lane, sampled at the rising clock edges
+        std::vector<uint32_t> samples;
+        uint32_t prev = first > 0 ? emu.edges[first - 1].pins : 0;
+        double last_rise = -1, last_data = -1;
+        for(size_t e=first;e<emu.edges.size();e++){
+            const auto pins = emu.edges[e].pins;
+            const double t = emu.edges[e].sys_cycle * emu.cycle_ns();
+            if((pins ^ prev) & data){
+                if(last_rise >= 0){
+                    res.hold.add(t - last_rise);
+                    if(t - last_rise < HOLD_MIN_ns){
+                        res.timing_errors++;
+                    }
+                }
+                last_data = t;
+            }
+            if((pins & clock) && !(prev & clock)){
+                samples.push_back(pins >> pin_base);
+                if(last_rise >= 0){
+                    res.period.add(t - last_rise);
+                }
+                if(last_data >= 0){
+                    res.setup.add(t - last_data);
+                    if(t - last_data < SETUP_MIN_ns){
+                        res.timing_errors++;
+                    }
+                }
+                last_rise = t;
+            }else if(!(pins & clock) && (prev & clock)){
+                res.high.add(t - last_rise);
+            }
+            prev = pins;
+        }
+        res.clocks += samples.size();
+        if(samples.size() != packet_words<LED>() * 8){
+            res.clock_count_errors++;
+            continue;
+        }
+
+        for(uint lane=0;lane<3;lane++){
+            auto byte = [&](const uint32_t k){
+                uint8_t v = 0;
+                for(uint32_t b=0;b<8;b++){
+                    v = (v << 1) | ((samples[k * 8 + b] >> lane) & 1);
+                }
+                return v;
+            };
+            bool frame_ok = true;
+            for(uint32_t k=0;k<LED::HEAD_WORDS;k++){
+                frame_ok = frame_ok && byte(k) == 0;
+            }
+            for(uint32_t k=packet_words<LED>()-LED::TAIL_WORDS;k<packet_words<LED>();k++){
+                frame_ok = frame_ok && byte(k) == 0;
+            }
+            for(uint32_t i=0;i<LENGTH;i++){
+                const uint32_t k = LED::HEAD_WORDS + i * LED::WORDS_PER_LED;
+                frame_ok = frame_ok && byte(k) == LED::LED_HEADER_BYTE;
+                // LED i of lane l is src[l][i*9 + 3*l] (R, G, B), sent as header, B, G, R
+                const uint8_t * rgb = &src[lane][i*9 + 3*lane];
+                if(byte(k + 1) != rgb[2] || byte(k + 2) != rgb[1] || byte(k + 3) != rgb[0]){
+                    res.value_errors++;
+                }
+            }
+            if(!frame_ok){
+                res.frame_errors++;
+            }
+        }
+    }
+
+    if(edges_file){
+        write_edges(edges_file, emu, pin_base, pin_count, CLOCK_PIN);
+    }
+
+    printf("# pio apa102 frames=%llu clocks=%llu image=%s words=%lu line=%.1fus period=%lluus idle=%.1fus"
+        " (%.0f lines/s max)\n",
+        (unsigned long long)res.frames, (unsigned long long)res.clocks, image_names[image_id(info)],
+        (unsigned long)packet_words<LED>(), line_us, (unsigned long long)period_us, period_us - line_us,
+        1e6 / line_us);
+    printf("clock %.0f-%.0f ns (%.2f MHz), high %.0f-%.0f ns\n", res.period.min, res.period.max,
+        LED::BIT_HZ / 1e6, res.high.min, res.high.max);
+    printf("setup %.0f-%.0f ns (>= %.0f), hold %.0f-%.0f ns (>= %.0f)\n", res.setup.min, res.setup.max, SETUP_MIN_ns,
+        res.hold.min, res.hold.max, HOLD_MIN_ns);
+    printf("timing_errors=%llu clock_count_errors=%llu frame_errors=%llu value_errors=%llu\n",
+        (unsigned long long)res.timing_errors, (unsigned long long)res.clock_count_errors,
+        (unsigned long long)res.frame_errors, (unsigned long long)res.value_errors);
+    for(const auto & e : emu.errors){
+        printf("emulator: %s\n", e.c_str());
+    }
+
+    const bool ok = res.timing_errors == 0 && res.clock_count_errors == 0 && res.frame_errors == 0
+        && res.value_errors == 0 && emu.errors.empty();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+}
+
+int pio_verify(int argc, char ** argv){
+    int dip = 9;
+    uint64_t lines = 50;
+    const char * edges_file = nullptr;
+    std::string led = "ws2812";
+    for(int i=0;i<argc;i++){
+        const std::string a = argv[i];
+        if(a == "--dip" && i + 1 < argc){
+            dip = atoi(argv[++i]);
+        }else if(a == "--lines" && i + 1 < argc){
+            lines = strtoull(argv[++i], nullptr, 10);
+        }else if(a == "--edges" && i + 1 < argc){
+            edges_file = argv[++i];
+        }else if(a == "--led" && i + 1 < argc){
+            led = argv[++i];
+        }else{
+            fprintf(stderr, "usage: oreore_sim pio [--dip N] [--lines N] [--edges FILE] [--led ws2812|apa102|sk6812]\n");
+            return 2;
+        }
+    }
+    if(led == "apa102"){
+        return pio_verify_apa102(dip, lines, edges_file);
+    }else if(led == "sk6812"){
+        return pio_verify_sk6812(dip, lines, edges_file);
+    }else if(led != "ws2812"){
+        fprintf(stderr, "unknown LED protocol: %s\n", led.c_str());
+        return 2;
+    }
+
+    // Same configuration as hal_pio_init (hal_rp2350.h)
+    const uint pin_base = 26;
+    const uint pin_count = 4;
+    const auto offset = pio_add_program(pio0, &ws2812_parallel_program);
+    const auto sm = pio_claim_unused_sm(pio0, true);
+    ws2812_parallel_program_init(pio0, sm, offset, pin_base, pin_count, 800000);
+    auto & emu = *pio0;
+
+    verify_result res;
+    double last_fall_ns = -1;
+
+    sim_set_output([&](const uint32_t * words, uint32_t count, uint64_t t_us){
+        emu.idle_until(t_us * (emu.sys_hz / 1000000));
+        const size_t first = emu.edges.size();
+        for(uint32_t i=0;i<count;i++){
+            pio_sm_put(pio0, sm, words[i]);
+        }
+        emu.run(sm, 1000ull * emu.sys_hz);
+        res.frames++;
+
+        // Colors seen by the strip vs colors packed into the words
+        std::vector<uint8_t> bytes[4];
+        decode_ws2812(emu, first, count, pin_base, pin_count, res, last_fall_ns, bytes);
+        for(uint lane=0;lane<pin_count;lane++){
+            if(bytes[lane].empty()){
+                continue;
+            }
+            const auto * b = bytes[lane].data();
+            for(uint32_t led=0;led<LENGTH;led++, b+=led_strip::WORDS_PER_LED){
+                const auto expected = lane_led(words, led, lane);
+                const bool white_ok = !led_strip::WHITE || b[led_strip::WORDS_PER_LED - 1] == expected.w;
+                if(b[led_strip::G] != expected.g || b[led_strip::R] != expected.r || b[led_strip::B] != expected.b || !white_ok){
+                    res.value_errors++;
+                }
+            }
+        }
+    });
+
+    sim_set_dip(dip);
+    poi_setup();
+    if(poi.selfbench){
+        fprintf(stderr, "DIP %d boots the self benchmark, no lines are sent\n", dip);
+        return 2;
+    }
+    while(res.frames < lines){
+        poi_loop_once();
+    }
+
+    if(edges_file){
+        write_edges(edges_file, emu, pin_base, pin_count, -1);
+    }
+
+    printf("# pio frames=%llu bits=%llu image=%s\n", (unsigned long long)res.frames, (unsigned long long)res.bits,
+        image_names[image_id(poi.info)]);
+    return report_ws2812(res, emu) ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <string.h>
+#include "png.h"
+
+namespace {
+
+uint32_t crc32(const uint8_t * p, size_t n, uint32_t crc = 0){
+    static uint32_t table[256];
+    if(table[1] == 0){
+        for(uint32_t i=0;i<256;i++){
+            uint32_t c = i;
+            for(int k=0;k<8;k++){
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for(size_t i=0;i<n;i++){
+        crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void put32(std::vector<uint8_t> & v, const uint32_t x){
+    v.push_back(x >> 24);
+    v.push_back(x >> 16);
+    v.push_back(x >> 8);
+    v.push_back(x);
+}
+
+void chunk(FILE * f, const char * type, const std::vector<uint8_t> & data){
+    std::vector<uint8_t> buf;
+    put32(buf, data.size());
+    buf.insert(buf.end(), type, type + 4);
+    buf.insert(buf.end(), data.begin(), data.end());
+    put32(buf, crc32(buf.data() + 4, buf.size() - 4));
+    fwrite(buf.data(), 1, buf.size(), f);
+}
+
+}
+
+bool write_png(const char * path, uint32_t width, uint32_t height, const std::vector<uint8_t> & rgb){
+    FILE * f = fopen(path, "wb");
+    if(!f){
+        return false;
+    }
+    static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(signature, 1, sizeof(signature), f);
+
+    std::vector<uint8_t> ihdr;
+    put32(ihdr, width);
+    put32(ihdr, height);
+    ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8bit, RGB, deflate, no filter, no interlace
+    chunk(f, "IHDR", ihdr);
+
+    // Scanlines with filter type 0
+    std::vector<uint8_t> raw;
+    raw.reserve((width * 3 + 1) * height);
+    for(uint32_t y=0;y<height;y++){
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * width * 3, rgb.begin() + (y + 1) * width * 3);
+    }
+
+    // zlib stream of stored blocks (max 65535 bytes each)
+    std::vector<uint8_t> z = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for(size_t pos=0;pos<raw.size() || pos==0;){
+        const size_t n = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+        z.push_back(pos + n == raw.size() ? 1 : 0);
+        z.push_back(n & 0xff);
+        z.push_back(n >> 8);
+        z.push_back(~n & 0xff);
+        z.push_back((~n >> 8) & 0xff);
+        z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+        for(size_t i=pos;i<pos+n;i++){
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += n;
+        if(n == 0){
+            break;
+        }
+    }
+    put32(z, (b << 16) | a);
+    chunk(f, "IDAT", z);
+    chunk(f, "IEND", {});
+
+    const bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,9 @@
+// Minimal PNG writer (8bit RGB, stored deflate blocks, no compression)
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// rgb: width * height * 3 bytes, top row first
+bool write_png(const char * path, uint32_t width, uint32_t height, const std::vector<uint8_t> & rgb);
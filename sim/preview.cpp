@@ -0,0 +1,244 @@
+// oreore_sim preview: long-exposure picture of a swung poi
+//
+// Runs the firmware (extractline, multiline stagger, reverse, mirror, loop) on the virtual clock,
+// decodes every DMA packet back into LEDs and composites them along a swing trajectory.
+// Light is accumulated while an LED holds its value (from the latch of a packet to the next one),
+// so the result looks like a photo taken with a long exposure.
+//
+// Geometry (pixels of the output image)
+//   Pixel 3i + l along the strip is LED i of lane l (lanes are interleaved by 1/3 LED).
+//   The strip starts at --hub from the rotation center (circle) or the top edge (linear).
+//   Lanes are stacked in the swing direction, lane 0 leads by 2 * --gap, lane 2 trails.
+//   Reverse mode (DIP bit 4) swings the other way.
+//
+// --shift / --mute / --solo / --channel set poi.style (packed-domain brightness and lane masks).
+// --brightness sets poi.brightness (0-256, temporal dithering below 256).
+
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "poi.h"
+#include "sim.h"
+#include "lanes.h"
+#include "png.h"
+#include "commands.h"
+
+namespace {
+
+const uint32_t LANES = 3;           // lane 3 is not connected
+const uint32_t PIXELS = LANES * LENGTH;
+
+struct preview_frame {
+    double t_ms;                    // latch time
+    uint8_t rgb[PIXELS][3];
+};
+
+struct preview_options {
+    int dip = 9;
+    const char * out = "preview.png";
+    bool circle = true;
+    double speed = 1;               // pixels per line (circle: at the middle of the strip)
+    double hub = 60;                // pixels
+    double gap = -1;                // pixels, < 0: one line at speed
+    double time_ms = -1;            // < 0: one revolution (circle) or one loop (linear)
+    double gain = 1;
+    packed_style style;
+    uint32_t brightness = 256;
+};
+
+int usage(){
+    fprintf(stderr,
+        "usage: oreore_sim preview [--dip N] [--out FILE] [--trajectory circle|linear] [--speed PX_PER_LINE]\n"
+        "                          [--hub PX] [--gap PX] [--time MS] [--gain X]\n"
+        "                          [--shift N] [--mute LANE] [--solo LANE] [--channel G|R|B|W:LANE_BITS] [--brightness 0-256]\n");
+    return 2;
+}
+
+struct canvas {
+    uint32_t width, height;
+    std::vector<float> acc;
+
+    canvas(uint32_t w, uint32_t h) : width(w), height(h), acc(w * h * 3, 0.0f) {
+    }
+
+    // Bilinear splat
+    void add(const double x, const double y, const uint8_t * rgb, const double weight){
+        const int x0 = static_cast<int>(floor(x));
+        const int y0 = static_cast<int>(floor(y));
+        const double fx = x - x0;
+        const double fy = y - y0;
+        for(int dy=0;dy<2;dy++){
+            for(int dx=0;dx<2;dx++){
+                const int px = x0 + dx;
+                const int py = y0 + dy;
+                if(px < 0 || py < 0 || px >= static_cast<int>(width) || py >= static_cast<int>(height)){
+                    continue;
+                }
+                const double w = weight * (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy);
+                auto * a = &acc[(py * width + px) * 3];
+                for(int c=0;c<3;c++){
+                    a[c] += static_cast<float>(rgb[c] * w);
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> to_rgb(const double gain) const {
+        std::vector<uint8_t> rgb(acc.size());
+        for(size_t i=0;i<acc.size();i++){
+            const double v = acc[i] * gain;
+            rgb[i] = v >= 255 ? 255 : static_cast<uint8_t>(v);
+        }
+        return rgb;
+    }
+};
+
+}
+
+int preview(int argc, char ** argv){
+    preview_options opt;
+    for(int i=0;i<argc;i++){
+        const std::string a = argv[i];
+        if(i + 1 >= argc){
+            return usage();
+        }
+        const char * v = argv[++i];
+        if(a == "--dip"){
+            opt.dip = atoi(v);
+        }else if(a == "--out"){
+            opt.out = v;
+        }else if(a == "--trajectory" && std::string(v) == "circle"){
+            opt.circle = true;
+        }else if(a == "--trajectory" && std::string(v) == "linear"){
+            opt.circle = false;
+        }else if(a == "--speed"){
+            opt.speed = atof(v);
+        }else if(a == "--hub"){
+            opt.hub = atof(v);
+        }else if(a == "--gap"){
+            opt.gap = atof(v);
+        }else if(a == "--time"){
+            opt.time_ms = atof(v);
+        }else if(a == "--gain"){
+            opt.gain = atof(v);
+        }else if(a == "--brightness"){
+            opt.brightness = atoi(v);
+        }else if(a == "--shift"){
+            opt.style.shift = atoi(v);
+        }else if(a == "--mute"){
+            opt.style.mute(atoi(v));
+        }else if(a == "--solo"){
+            opt.style.solo(atoi(v));
+        }else if(a == "--channel"){
+            // C:LANE_BITS, C is one of G, R, B, W (strchr also finds the terminator, so v[0] is checked first)
+            const char * c = v[0] ? strchr("GRBW", v[0]) : nullptr;
+            if(!c || v[1] != ':' || !v[2]){
+                return usage();
+            }
+            char * end;
+            const auto lanes = strtoul(v + 2, &end, 0);
+            if(*end){
+                return usage();
+            }
+            opt.style.channel(c - "GRBW", lanes);
+        }else{
+            return usage();
+        }
+    }
+
+    // Capture latched frames
+    std::vector<preview_frame> frames;
+    const double word_ms = sim_word_ns() / 1e6;
+    sim_set_output([&](const uint32_t * words, uint32_t count, uint64_t t_us){
+        preview_frame f;
+        f.t_ms = t_us / 1e3 + count * word_ms;
+        for(uint32_t i=0;i<LENGTH;i++){
+            for(uint32_t l=0;l<LANES;l++){
+                const auto led = lane_led(words, i, l);
+                auto * p = f.rgb[i * LANES + l];
+                // W of RGBW strips lights all three channels (white_lut in oreore_poi.cpp)
+                p[0] = std::min(255, led.r + led.w);
+                p[1] = std::min(255, led.g + led.w);
+                p[2] = std::min(255, led.b + led.w);
+            }
+        }
+        frames.push_back(f);
+    });
+
+    sim_set_dip(opt.dip);
+    poi_setup();
+    poi.style = opt.style;
+    poi.brightness = opt.brightness;
+    const auto info = poi.info;
+    const double period_ms = info->period_us / 1e3;
+    const double dir = poi.reverse ? -1 : 1;
+    const double mid = opt.hub + PIXELS / 2.0;
+    const double gap = opt.gap >= 0 ? opt.gap : opt.speed;
+    const double v = opt.speed / period_ms;     // pixels per ms (circle: at mid)
+    if(opt.time_ms < 0){
+        const double loop_lines = info->mirror ? info->height * 2 : info->height;
+        opt.time_ms = opt.circle ? 2 * M_PI * mid / v : (loop_lines + 2) * period_ms;
+    }
+    while(sim_now_us() < opt.time_ms * 1e3){
+        poi_loop_once();
+    }
+    sim_set_output(nullptr);
+
+    // Trajectory: position of pixel r of lane l at t
+    const double extent = PIXELS + opt.hub + 2 * gap + 2;
+    const uint32_t width = opt.circle ? 2 * extent : v * opt.time_ms + 2 * gap + 4;
+    const uint32_t height = opt.circle ? 2 * extent : opt.hub + PIXELS + 2;
+    auto position = [&](const double t, const uint32_t r, const uint32_t lane, double & x, double & y){
+        const double lead = (LANES - 1 - lane) * gap;
+        const double radius = opt.hub + r;
+        const double u = dir * v * t + lead;   // along the swing (pixels at mid for circle)
+        if(opt.circle){
+            const double phi = u / mid;
+            x = extent + radius * cos(phi);
+            y = extent - radius * sin(phi);
+        }else{
+            x = u + (dir > 0 ? 1 : width - 2 - 2 * gap);
+            y = radius;
+        }
+    };
+
+    canvas cv(width, height);
+    for(size_t k=0;k<frames.size();k++){
+        const auto & f = frames[k];
+        const double t0 = f.t_ms;
+        const double t1 = k + 1 < frames.size() ? frames[k + 1].t_ms : opt.time_ms;
+        if(t1 <= t0){
+            continue;
+        }
+        // Steps of <= 0.5 pixel at the outer end
+        const double travel = v * (t1 - t0) * (opt.circle ? (opt.hub + PIXELS) / mid : 1);
+        const uint32_t steps = static_cast<uint32_t>(ceil(travel / 0.5)) + 1;
+        const double dt = (t1 - t0) / steps;
+        for(uint32_t s=0;s<steps;s++){
+            const double t = t0 + (s + 0.5) * dt;
+            for(uint32_t r=0;r<PIXELS;r++){
+                const auto * rgb = f.rgb[r];
+                if((rgb[0] | rgb[1] | rgb[2]) == 0){
+                    continue;
+                }
+                double x, y;
+                position(t, r, r % LANES, x, y);
+                // Light per pixel of travel does not depend on the speed
+                const double weight = v * dt * (opt.circle ? (opt.hub + r) / mid : 1);
+                cv.add(x, y, rgb, weight);
+            }
+        }
+    }
+
+    if(!write_png(opt.out, cv.width, cv.height, cv.to_rgb(opt.gain))){
+        perror(opt.out);
+        return 1;
+    }
+    printf("# preview image=%s reverse=%d frames=%zu %.0fms %ux%u -> %s\n", image_names[image_id(info)],
+        poi.reverse ? 1 : 0, frames.size(), opt.time_ms, cv.width, cv.height, opt.out);
+    return 0;
+}
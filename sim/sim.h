@@ -0,0 +1,54 @@
+// Control of the host implementation of hal.h (virtual clock, GPIO inputs, output capture)
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <vector>
+
+// Called at every DMA trigger with the packet and the virtual time [us]
+typedef std::function<void(const uint32_t * words, uint32_t count, uint64_t t_us)> sim_output_cbk;
+
+struct sim_stats {
+    uint64_t lines;         // DMA transfers
+    uint64_t dma_overlaps;  // DMA triggered while the previous transfer was running
+    uint64_t dma_irqs;
+    uint64_t replayed;      // RUN lines which used a recorded line
+};
+
+// Line recorded by the device telemetry (telemetry.h), replayed as the cost model of RUN lines
+struct sim_replay_line {
+    uint32_t fetch_us;      // FETCH_END - FETCH_START
+    uint32_t pack_us;       // PACK_END - FETCH_END
+    uint32_t trigger_us;    // DMA_START - max(DEADLINE, PACK_END): sleep overshoot, IRQs before the trigger
+    uint32_t dma_us;        // DMA_DONE - DMA_START (0: not recorded)
+    uint32_t events;        // tlm_event bits
+};
+
+// DIP switch value as get_dip_value() returns
+void sim_set_dip(int value);
+
+// Push switch is pressed at at_us and released at at_us + hold_us
+// dip >= 0 changes DIP switches while the push switch is down
+void sim_press(uint64_t at_us, uint64_t hold_us, int dip = -1);
+
+// Virtual time spent per host time spent between HAL calls (0: computation costs nothing)
+void sim_set_cost_scale(double scale);
+
+// Fetch / pack of every RUN line take at least the recorded time, the DMA trigger is delayed and
+// the transfer is stretched as recorded. Lines are used cyclically (empty: off).
+void sim_set_replay(const std::vector<sim_replay_line> & lines);
+
+void sim_set_output(sim_output_cbk cbk);
+
+// Raw USB CDC output (hal_cdc_write) goes to `f` with the bandwidth of USB full speed (nullptr: not connected)
+void sim_set_cdc(FILE * f);
+
+// Records HAL activity (sleep / work on core0, DMA transfers, IRQs) into `trace` (nullptr: off)
+class trace_writer;
+void sim_set_trace(trace_writer * trace);
+
+uint64_t sim_now_us();
+uint64_t sim_word_ns();     // time to send one PIO FIFO word
+const sim_stats & sim_get_stats();
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include "trace.h"
+
+bool trace_writer::write(const char * path) const {
+    FILE * f = fopen(path, "w");
+    if(!f){
+        return false;
+    }
+    static const struct {
+        trace_track track;
+        const char * name;
+    } tracks[] = {
+        {TRACE_CORE0, "core0"}, {TRACE_LINE, "line"}, {TRACE_DMA, "dma"}, {TRACE_IRQ, "irq"},
+    };
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"oreore_sim\"}}");
+    for(const auto & t : tracks){
+        fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", t.track, t.name);
+        fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", t.track, t.track);
+    }
+    for(const auto & e : events){
+        fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,", e.name.c_str(), e.ph, (unsigned long long)e.ts_us);
+        if(e.ph == 'X'){
+            fprintf(f, "\"dur\":%llu,", (unsigned long long)e.dur_us);
+        }else{
+            fprintf(f, "\"s\":\"t\",");
+        }
+        fprintf(f, "\"pid\":1,\"tid\":%d,\"args\":{%s}}", e.track, e.args.c_str());
+    }
+    fprintf(f, "\n]}\n");
+    const bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,40 @@
+// Chrome trace event JSON writer (chrome://tracing, https://ui.perfetto.dev)
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum trace_track {
+    TRACE_CORE0 = 1,    // main loop: work / sleep
+    TRACE_LINE,         // one span per line (DMA trigger to DMA trigger)
+    TRACE_DMA,          // DMA transfers
+    TRACE_IRQ,          // DMA completion, GPIO edges
+};
+
+struct trace_event {
+    std::string name;
+    char ph;            // 'X': complete, 'i': instant
+    uint64_t ts_us;
+    uint64_t dur_us;
+    trace_track track;
+    std::string args;   // JSON object body (without braces)
+};
+
+class trace_writer {
+public:
+    void span(trace_track track, const std::string & name, uint64_t t0_us, uint64_t dur_us, const std::string & args = ""){
+        events.push_back({name, 'X', t0_us, dur_us, track, args});
+    }
+    void instant(trace_track track, const std::string & name, uint64_t t_us, const std::string & args = ""){
+        events.push_back({name, 'i', t_us, 0, track, args});
+    }
+    size_t size() const {
+        return events.size();
+    }
+    bool write(const char * path) const;
+
+private:
+    std::vector<trace_event> events;
+};
@@ -0,0 +1,97 @@
+# sram_map.py
+# This script prints the build-time SRAM map of oreore_poi: static buffers per bank, the arenas
+# of arena.h, stacks and heap, and checks them against the 520KB of RP2350.
+
+# Usage
+# $ python ./sram_map.py build/oreore_poi.elf
+# $ python ./sram_map.py build/oreore_poi.elf --top 40
+#
+# Banks
+#   SRAM0-7    0x20000000 - 0x2007ffff  512KB, striped (.data, .bss, heap, arena_main)
+#   SRAM8      0x20080000 - 0x20080fff  4KB, scratch_x (arena_scratch_x, core1 stack)
+#   SRAM9      0x20081000 - 0x20081fff  4KB, scratch_y (core0 stack)
+# Tools are arm-none-eabi-nm (set TOOLCHAIN_PREFIX to override the prefix).
+# Exit code is 1 if static data overlaps the stacks or a bank is exceeded.
+
+import argparse
+import os
+import subprocess
+import sys
+
+PREFIX = os.environ.get('TOOLCHAIN_PREFIX', 'arm-none-eabi-')
+
+BANKS = [
+  ('SRAM0-7', 0x20000000, 0x20080000),
+  ('SRAM8', 0x20080000, 0x20081000),
+  ('SRAM9', 0x20081000, 0x20082000),
+]
+
+def load_symbols(elf):
+  # address size type name
+  # (symbols without size: address type name)
+  out = subprocess.run([PREFIX + 'nm', '-n', '-S', '-C', '--defined-only', elf],
+                       capture_output=True, text=True, check=True).stdout
+  symbols = []
+  markers = {}
+  for line in out.splitlines():
+    v = line.split(None, 3)
+    if len(v) == 4 and len(v[2]) == 1:
+      symbols.append((int(v[0], 16), int(v[1], 16), v[2], v[3]))
+    elif len(v) >= 3:
+      markers[line.split(None, 2)[2]] = int(v[0], 16)
+  return symbols, markers
+
+def bank_of(addr):
+  for name, start, end in BANKS:
+    if start <= addr < end:
+      return name
+  return None
+
+def main():
+  p = argparse.ArgumentParser(description='Build-time SRAM map')
+  p.add_argument('elf')
+  p.add_argument('--top', type=int, default=20, help='largest symbols to list')
+  args = p.parse_args()
+
+  symbols, markers = load_symbols(args.elf)
+  sram = [s for s in symbols if bank_of(s[0]) and s[2] in 'bBdDrRuVv']
+  failed = 0
+
+  print('# sram map of %s' % args.elf)
+  print('bank,used,size,percent')
+  used = {}
+  for addr, size, _, _ in sram:
+    used[bank_of(addr)] = used.get(bank_of(addr), 0) + size
+  for name, start, end in BANKS:
+    u = used.get(name, 0)
+    print('%s,%d,%d,%.1f%%' % (name, u, end - start, u * 100.0 / (end - start)))
+    if u > end - start:
+      failed += 1
+
+  print('# arenas (arena.h)')
+  for addr, size, _, name in sram:
+    if name.startswith('arena_') and name.endswith('_mem'):
+      print('%s,%s,0x%08x,%d' % (name[:-len('_mem')], bank_of(addr), addr, size))
+
+  # Linker symbols of the pico SDK
+  end = markers.get('end', markers.get('__bss_end__'))
+  stack_limit = markers.get('__StackLimit')
+  heap_limit = markers.get('__HeapLimit')
+  if end and stack_limit:
+    print('# heap 0x%08x - 0x%08x (%d bytes)' % (end, heap_limit or stack_limit, (heap_limit or stack_limit) - end))
+    if end > stack_limit:
+      print('# static data overlaps the stack')
+      failed += 1
+  for name in ('__StackOneBottom', '__StackBottom'):
+    if name in markers:
+      print('# %s 0x%08x (%s)' % (name, markers[name], bank_of(markers[name])))
+
+  print('# largest symbols')
+  print('symbol,bank,address,bytes')
+  for addr, size, _, name in sorted(sram, key=lambda s: -s[1])[:args.top]:
+    print('%s,%s,0x%08x,%d' % (name, bank_of(addr), addr, size))
+
+  sys.exit(1 if failed else 0)
+
+if __name__ == '__main__':
+  main()
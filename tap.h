@@ -0,0 +1,114 @@
+// Live output tap
+//
+// Enabled by OREORE_TAP (cmake -DOREORE_TAP=ON), every OREORE_TAP_EVERY-th RUN line is mirrored.
+// The packed line is copied into a frame which is streamed over USB CDC in pieces, as much as the
+// TinyUSB FIFO accepts on each line (hal_cdc_write never blocks). If the previous frame is still
+// being streamed when the next tapped line comes, that line is dropped and counted.
+// tap_view.py decodes frames into LED colors on the host.
+//
+// Frame (little endian)
+//   u32 magic "TAP2", u32 seq, u32 line, i32 idx, u16 image, u16 words, u32 dropped,
+//   u8 head_words, u8 words_per_led, u16 leds,                   layout of the LED protocol (led_strip)
+//   u8 g, u8 r, u8 b, u8 w,                                      word of each channel in an LED (w = 0xff: RGB)
+//   u32 words[words], u32 FNV-1a of everything before
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if OREORE_TAP
+
+#ifndef OREORE_TAP_EVERY
+#define OREORE_TAP_EVERY 8
+#endif
+
+const uint32_t TAP_MAGIC = 0x32504154; // "TAP2"
+const uint32_t TAP_HEADER_BYTES = 32;
+
+template<class LED>
+constexpr uint32_t tap_channels(){
+    uint32_t w = 0xff;
+    if constexpr (LED::WHITE){
+        w = LED::W;
+    }
+    return LED::G | (LED::R << 8) | (LED::B << 16) | (w << 24);
+}
+
+struct tap_state {
+    uint8_t frame[TAP_HEADER_BYTES + PACKET_WORDS*4 + 4];
+    uint32_t size = 0;
+    uint32_t sent = 0;
+    uint32_t lines = 0;
+    uint32_t frames = 0;        // started
+    uint32_t dropped = 0;
+
+    static uint8_t * put32(uint8_t * p, const uint32_t v){
+        memcpy(p, &v, 4);   // little endian CPU
+        return p + 4;
+    }
+
+    // After pack, before DMA
+    void line(const uint32_t (&packet)[PACKET_WORDS], const int32_t idx, const uint32_t image){
+        const auto n = lines++;
+        if(n % OREORE_TAP_EVERY){
+            return;
+        }
+        if(sent < size){
+            dropped++;
+            return;
+        }
+        auto p = frame;
+        p = put32(p, TAP_MAGIC);
+        p = put32(p, frames++);
+        p = put32(p, n);
+        p = put32(p, static_cast<uint32_t>(idx));
+        p = put32(p, (image & 0xffff) | (PACKET_WORDS << 16));
+        p = put32(p, dropped);
+        p = put32(p, led_strip::HEAD_WORDS | (led_strip::WORDS_PER_LED << 8) | (LENGTH << 16));
+        p = put32(p, tap_channels<led_strip>());
+        memcpy(p, packet, sizeof(packet));
+        p += sizeof(packet);
+        uint32_t h = 0x811c9dc5;
+        for(const uint8_t * q=frame;q<p;q++){
+            h = (h ^ *q) * 0x01000193;
+        }
+        p = put32(p, h);
+        size = p - frame;
+        sent = 0;
+    }
+
+    // Streams as much as the CDC FIFO accepts (every line and while polling in WAIT / HALT)
+    void poll(){
+        if(sent >= size){
+            return;
+        }
+        const auto avail = hal_cdc_write_available();
+        if(avail == 0){
+            return;
+        }
+        const auto n = size - sent < avail ? size - sent : avail;
+        sent += hal_cdc_write(frame + sent, n);
+        hal_cdc_flush();
+    }
+};
+
+tap_state tap;
+
+void tap_dump(){
+    printf("# tap every=%lu lines=%lu frames=%lu dropped=%lu\n", (unsigned long)OREORE_TAP_EVERY,
+        (unsigned long)tap.lines, (unsigned long)tap.frames, (unsigned long)tap.dropped);
+}
+
+#define TAP_LINE(packet, idx, image) tap.line((packet), (idx), (image))
+#define TAP_POLL() tap.poll()
+#define TAP_DUMP() tap_dump()
+
+#else
+
+#define TAP_LINE(packet, idx, image) ((void)0)
+#define TAP_POLL() ((void)0)
+#define TAP_DUMP() ((void)0)
+
+#endif
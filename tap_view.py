@@ -0,0 +1,133 @@
+# tap_view.py
+# This script shows packed lines mirrored by the output tap (OREORE_TAP=ON) as LED colors
+# in the terminal (24bit color ANSI escapes).
+
+# Usage
+# $ python ./tap_view.py --serial /dev/ttyACM0
+# $ python ./tap_view.py tap.bin [--delay SEC]     (oreore_sim run --tap tap.bin)
+#
+# Text reports printed over the same USB CDC are skipped (frames are found by the magic).
+
+import struct
+import sys
+import time
+
+TAP_MAGIC = b'TAP2'
+HEADER = struct.Struct('<4sIIiHHIBBHBBBB')
+LANES = 3
+
+def fnv1a(data):
+  h = 0x811c9dc5
+  for b in data:
+    h = ((h ^ b) * 0x01000193) & 0xffffffff
+  return h
+
+def lane_byte(word, lane):
+  v = 0
+  for k in range(8):
+    v = (v << 1) | ((word >> (4 * k + lane)) & 1)
+  return v
+
+def decode(frame):
+  # LED i starts at word head + i * per_led, lane n is bit n of each nibble
+  # W (RGBW strips) lights all three colors
+  words = frame['words']
+  head, per_led, count = frame['layout']
+  g, r, b, w = frame['channels']
+  lanes = []
+  for lane in range(LANES):
+    leds = []
+    for i in range(count):
+      led = words[head + i * per_led:head + (i + 1) * per_led]
+      white = lane_byte(led[w], lane) if w != 0xff else 0
+      leds.append(tuple(min(255, lane_byte(led[c], lane) + white) for c in (r, g, b)))
+    lanes.append(leds)
+  return lanes
+
+class parser:
+  def __init__(self):
+    self.buf = b''
+    self.bad = 0
+
+  def feed(self, data):
+    self.buf += data
+    frames = []
+    while True:
+      start = self.buf.find(TAP_MAGIC)
+      if start < 0:
+        self.buf = self.buf[-3:]
+        return frames
+      self.buf = self.buf[start:]
+      if len(self.buf) < HEADER.size:
+        return frames
+      _, seq, line, idx, image, words, dropped, head, per_led, leds, g, r, b, w = HEADER.unpack_from(self.buf)
+      size = HEADER.size + words * 4 + 4
+      if len(self.buf) < size:
+        return frames
+      frame = self.buf[:size]
+      (check,) = struct.unpack_from('<I', frame, size - 4)
+      if fnv1a(frame[:size - 4]) != check:
+        self.bad += 1
+        self.buf = self.buf[4:]
+        continue
+      self.buf = self.buf[size:]
+      if head + per_led * leds > words or max(g, r, b) >= per_led or (w != 0xff and w >= per_led):
+        self.bad += 1   # layout does not fit the packet
+        continue
+      frames.append({'seq': seq, 'line': line, 'idx': idx, 'image': image, 'dropped': dropped,
+                     'layout': (head, per_led, leds), 'channels': (g, r, b, w),
+                     'words': struct.unpack_from('<%dI' % words, frame, HEADER.size)})
+
+def show(frame, lost, bad):
+  out = ['\x1b[H']
+  out.append('seq=%-8d line=%-8d idx=%-6d image=%-3d dropped(device)=%-6d lost(host)=%-6d bad=%-4d\x1b[K\n' %
+             (frame['seq'], frame['line'], frame['idx'], frame['image'], frame['dropped'], lost, bad))
+  for lane, leds in enumerate(decode(frame)):
+    out.append('lane%d ' % lane)
+    for r, g, b in leds:
+      out.append('\x1b[38;2;%d;%d;%dm█' % (r, g, b))
+    out.append('\x1b[0m\x1b[K\n')
+  sys.stdout.write(''.join(out))
+  sys.stdout.flush()
+
+def main():
+  args = sys.argv[1:]
+  delay = 0.0
+  if '--delay' in args:
+    i = args.index('--delay')
+    delay = float(args[i + 1])
+    del args[i:i + 2]
+  if len(args) == 2 and args[0] == '--serial':
+    import serial
+    src = serial.Serial(args[1], timeout=0.1)
+    read = lambda: src.read(4096)
+  elif len(args) == 1:
+    src = open(args[0], 'rb')
+    read = lambda: src.read(4096) or None
+  else:
+    sys.exit('usage: tap_view.py [--serial PORT | FILE [--delay SEC]]')
+
+  p = parser()
+  last_seq = None
+  lost = 0
+  frames = 0
+  sys.stdout.write('\x1b[2J')
+  try:
+    while True:
+      data = read()
+      if data is None:
+        break
+      for f in p.feed(data):
+        if last_seq is not None and f['seq'] != last_seq + 1:
+          lost += (f['seq'] - last_seq - 1) & 0xffffffff
+        last_seq = f['seq']
+        frames += 1
+        show(f, lost, p.bad)
+        if delay:
+          time.sleep(delay)
+  except KeyboardInterrupt:
+    pass
+  print('%d frames, lost %d, bad %d' % (frames, lost, p.bad))
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,276 @@
+// Per-line timing telemetry
+//
+// Enabled by OREORE_TELEMETRY (cmake -DOREORE_TELEMETRY=ON).
+// Every line drawn in State RUN records following timestamps (hal_time_us32):
+//
+//   FETCH_START  line processing starts (extractline)
+//   FETCH_END    all source rows are fetched
+//   PACK_END     pack_parallel / pack_parallel_sft finished
+//   DMA_START    DMA is triggered
+//   DMA_DONE     DMA completion IRQ (0 until it fires)
+//   DEADLINE     scheduled DMA trigger (time grid of period_us)
+//
+// and events which happened during the line (tlm_event bits), so recordings from the field
+// can be replayed by the simulator (oreore_sim run --replay).
+//
+// Records are kept in a ring buffer which is written by the main loop (and DMA_DONE by the IRQ)
+// without locks. The ring can be read over USB (telemetry_dump) or directly through SWD
+// (dump the "telemetry" symbol and pass it to telemetry_plot.py --bin).
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+enum tlm_stamp {
+    TLM_FETCH_START = 0,
+    TLM_FETCH_END,
+    TLM_PACK_END,
+    TLM_DMA_START,
+    TLM_DMA_DONE,
+    TLM_DEADLINE,
+    TLM_NUM_STAMPS
+};
+
+enum tlm_hist {
+    TLM_HIST_FETCH = 0, // FETCH_END - FETCH_START
+    TLM_HIST_PACK,      // PACK_END - FETCH_END
+    TLM_HIST_SLACK,     // DEADLINE - PACK_END (time left for sleep_until)
+    TLM_HIST_JITTER,    // DMA_START - DEADLINE
+    TLM_HIST_DMA,       // DMA_DONE - DMA_START
+    TLM_NUM_HIST
+};
+
+enum tlm_event {
+    TLM_EV_GPIO_IRQ = 0x1,  // push switch IRQ while the line was processed
+    TLM_EV_DMA_IRQ = 0x2,   // DMA IRQ of the previous line arrived during fetch / pack
+    TLM_EV_DMA_LATE = 0x4,  // the previous DMA was still running at the trigger
+    TLM_EV_MISSED = 0x8,    // PACK_END was later than DEADLINE
+    TLM_EV_SKIP = 0x10,     // overload policy skipped rows after this line
+    TLM_EV_REPEAT = 0x20,   // overload policy dropped this line (not committed, counted only)
+    TLM_EV_CHEAP = 0x40     // packed by the cheaper path of OVERLOAD_CHEAP
+};
+
+struct tlm_record {
+    uint32_t stamp[TLM_NUM_STAMPS];
+    int32_t idx;        // row index of the line
+    uint32_t image;     // index of image_table
+    uint32_t events;    // tlm_event bits
+};
+
+// Histogram with 64 linear buckets of (1 << shift) us and an overflow bucket
+struct tlm_histogram {
+    static const uint32_t BUCKETS = 64;
+
+    uint32_t shift;
+    uint32_t samples;
+    uint32_t max;
+    uint32_t count[BUCKETS + 1];
+
+    void add(const uint32_t v){
+        auto b = v >> shift;
+        if(b > BUCKETS){
+            b = BUCKETS;
+        }
+        count[b]++;
+        samples++;
+        if(max < v){
+            max = v;
+        }
+    }
+
+    // Returns the upper bound of the bucket which contains pct percentile
+    uint32_t percentile(const uint32_t pct) const {
+        if(samples == 0){
+            return 0;
+        }
+        const uint64_t target = (static_cast<uint64_t>(samples) * pct + 99) / 100;
+        uint64_t acc = 0;
+        for(uint32_t b=0;b<BUCKETS;b++){
+            acc += count[b];
+            if(acc >= target){
+                const auto upper = ((b + 1) << shift) - 1;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+};
+
+const uint32_t TLM_MAGIC = 0x314d4c54; // "TLM1"
+const uint32_t TLM_DEPTH = 256;        // must be power of 2
+
+struct tlm_ring {
+    // Header (read by telemetry_plot.py --bin, keep the layout)
+    uint32_t magic = TLM_MAGIC;
+    uint32_t depth = TLM_DEPTH;
+    uint32_t record_size = sizeof(tlm_record);
+    volatile uint32_t head = 0;            // the number of committed records
+    volatile uint32_t missed_deadline = 0; // PACK_END was later than DEADLINE
+    volatile uint32_t dma_late = 0;        // DMA was still running at the next trigger
+
+    tlm_record rec[TLM_DEPTH] = {};
+    tlm_histogram hist[TLM_NUM_HIST] = {
+        {1}, // FETCH:  0 - 128us
+        {2}, // PACK:   0 - 256us
+        {6}, // SLACK:  0 - 4ms
+        {1}, // JITTER: 0 - 128us
+        {6}, // DMA:    0 - 4ms
+    };
+
+    // Record of the line which is currently being processed, and the line which DMA is sending
+    tlm_record * volatile current = nullptr;
+    tlm_record * volatile inflight = nullptr;
+
+    // Decisions of the overload policy (after the records, the binary layout above is kept)
+    uint32_t skipped_rows = 0;
+    uint32_t repeated_lines = 0;
+    uint32_t cheap_lines = 0;
+
+    void begin(const int32_t idx, const uint32_t image, const uint32_t t, const uint32_t deadline){
+        auto r = &rec[head & (TLM_DEPTH - 1)];
+        for(auto & s : r->stamp){
+            s = 0;
+        }
+        r->stamp[TLM_FETCH_START] = t;
+        r->stamp[TLM_DEADLINE] = deadline;
+        r->idx = idx;
+        r->image = image;
+        r->events = 0;
+        current = r;
+    }
+
+    void stamp(const tlm_stamp s, const uint32_t t){
+        if(current){
+            current->stamp[s] = t;
+        }
+    }
+
+    // Called from IRQs too
+    void event(const tlm_event e){
+        auto r = current;
+        if(r){
+            r->events |= e;
+        }
+    }
+
+    void overload(const tlm_event e, const uint32_t n){
+        event(e);
+        if(e == TLM_EV_SKIP){
+            skipped_rows += n;
+        }else if(e == TLM_EV_REPEAT){
+            repeated_lines += n;
+        }else if(e == TLM_EV_CHEAP){
+            cheap_lines += n;
+        }
+    }
+
+    // Called just before the DMA trigger. Commits current record.
+    void dma_start(const uint32_t t){
+        auto r = current;
+        if(!r){
+            return;
+        }
+        r->stamp[TLM_DMA_START] = t;
+
+        const auto prev = inflight;
+        if(prev && prev->stamp[TLM_DMA_DONE] == 0){
+            dma_late = dma_late + 1;
+            r->events |= TLM_EV_DMA_LATE;
+        }
+
+        const auto * s = r->stamp;
+        const auto late = static_cast<int32_t>(s[TLM_PACK_END] - s[TLM_DEADLINE]);
+        if(late > 0){
+            missed_deadline = missed_deadline + 1;
+            r->events |= TLM_EV_MISSED;
+        }
+        hist[TLM_HIST_FETCH].add(s[TLM_FETCH_END] - s[TLM_FETCH_START]);
+        hist[TLM_HIST_PACK].add(s[TLM_PACK_END] - s[TLM_FETCH_END]);
+        hist[TLM_HIST_SLACK].add(late > 0 ? 0 : static_cast<uint32_t>(-late));
+        const auto jitter = static_cast<int32_t>(t - s[TLM_DEADLINE]);
+        hist[TLM_HIST_JITTER].add(jitter > 0 ? static_cast<uint32_t>(jitter) : 0);
+
+        // Publish the record before head moves
+        std::atomic_signal_fence(std::memory_order_release);
+        inflight = r;
+        current = nullptr;
+        head = head + 1;
+    }
+
+    // Called from DMA IRQ
+    void dma_done(const uint32_t t){
+        const auto c = current;
+        if(c && c->stamp[TLM_PACK_END] == 0){
+            c->events |= TLM_EV_DMA_IRQ;
+        }
+        auto r = inflight;
+        if(!r || r->stamp[TLM_DMA_DONE] != 0){
+            return;
+        }
+        r->stamp[TLM_DMA_DONE] = t ? t : 1;
+        hist[TLM_HIST_DMA].add(t - r->stamp[TLM_DMA_START]);
+    }
+
+    // Lines which are not recorded (State WAIT) use DMA too
+    void idle(){
+        current = nullptr;
+        inflight = nullptr;
+    }
+};
+
+#if OREORE_TELEMETRY
+
+// inline: also included by sim/latency.cpp (through latency.h)
+inline tlm_ring telemetry;
+
+#define TELEMETRY_BEGIN(idx, image, t, deadline) telemetry.begin((idx), (image), (t), (deadline))
+#define TELEMETRY_STAMP(s) telemetry.stamp((s), hal_time_us32())
+#define TELEMETRY_DMA_START() telemetry.dma_start(hal_time_us32())
+#define TELEMETRY_DMA_DONE() telemetry.dma_done(hal_time_us32())
+#define TELEMETRY_EVENT(e) telemetry.event(e)
+#define TELEMETRY_OVERLOAD(e, n) telemetry.overload((e), (n))
+#define TELEMETRY_IDLE() telemetry.idle()
+#define TELEMETRY_DUMP(names) telemetry_dump(names)
+
+// Prints summary, histograms and records (oldest first) as CSV
+inline void telemetry_dump(const char * const * image_names){
+    static const char * hist_names[TLM_NUM_HIST] = {"fetch", "pack", "slack", "jitter", "dma"};
+
+    const uint32_t head = telemetry.head;
+    printf("# telemetry lines=%lu missed_deadline=%lu dma_late=%lu\n",
+        (unsigned long)head, (unsigned long)telemetry.missed_deadline, (unsigned long)telemetry.dma_late);
+    printf("# overload skipped_rows=%lu repeated_lines=%lu cheap_lines=%lu\n",
+        (unsigned long)telemetry.skipped_rows, (unsigned long)telemetry.repeated_lines, (unsigned long)telemetry.cheap_lines);
+    for(uint32_t h=0;h<TLM_NUM_HIST;h++){
+        const auto & hist = telemetry.hist[h];
+        printf("# hist %s samples=%lu p50=%lu p99=%lu max=%lu\n", hist_names[h],
+            (unsigned long)hist.samples, (unsigned long)hist.percentile(50),
+            (unsigned long)hist.percentile(99), (unsigned long)hist.max);
+    }
+
+    printf("line,image,idx,fetch_start,fetch_end,pack_end,dma_start,dma_done,deadline,events\n");
+    const uint32_t first = head > TLM_DEPTH ? head - TLM_DEPTH : 0;
+    for(uint32_t n=first;n<head;n++){
+        const auto & r = telemetry.rec[n & (TLM_DEPTH - 1)];
+        printf("%lu,%s,%ld", (unsigned long)n, image_names[r.image], (long)r.idx);
+        for(auto s : r.stamp){
+            printf(",%lu", (unsigned long)s);
+        }
+        printf(",%lu\n", (unsigned long)r.events);
+    }
+}
+
+#else
+
+#define TELEMETRY_BEGIN(idx, image, t, deadline) ((void)0)
+#define TELEMETRY_STAMP(s) ((void)0)
+#define TELEMETRY_DMA_START() ((void)0)
+#define TELEMETRY_DMA_DONE() ((void)0)
+#define TELEMETRY_EVENT(e) ((void)0)
+#define TELEMETRY_OVERLOAD(e, n) ((void)0)
+#define TELEMETRY_IDLE() ((void)0)
+#define TELEMETRY_DUMP(names) ((void)0)
+
+#endif
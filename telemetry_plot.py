@@ -0,0 +1,141 @@
+# telemetry_plot.py
+# This script plots per-line timing telemetry recorded by oreore_poi (OREORE_TELEMETRY=ON).
+
+# Usage
+# 1. USB: press the push switch, and telemetry is printed to USB CDC
+# $ python ./telemetry_plot.py capture.txt
+# $ python ./telemetry_plot.py --serial /dev/ttyACM0
+#
+# 2. SWD: dump "telemetry" symbol while the program is running
+# $ arm-none-eabi-nm -S build/oreore_poi.elf | grep " telemetry$"
+#   (address and size are printed)
+# $ openocd -f raspberrypi-swd.cfg -f target/rp2350.cfg -c "init; dump_image telemetry.bin <address> <size>; exit"
+# $ python ./telemetry_plot.py --bin telemetry.bin
+
+import sys
+import struct
+
+STAMPS = ['fetch_start', 'fetch_end', 'pack_end', 'dma_start', 'dma_done', 'deadline']
+EVENTS = [('gpio_irq', 0x1), ('dma_irq', 0x2), ('dma_late', 0x4), ('missed', 0x8),   # tlm_event
+          ('skip', 0x10), ('repeat', 0x20), ('cheap', 0x40)]
+TLM_MAGIC = 0x314d4c54
+
+def parse_csv(lines):
+  records = []
+  header = []
+  columns = None
+  for line in lines:
+    line = line.strip()
+    if line.startswith('#'):
+      header.append(line)
+      continue
+    if line.startswith('line,'):
+      columns = line.split(',')
+      records = []
+      continue
+    if columns is None or line.count(',') != len(columns) - 1:
+      continue
+    v = line.split(',')
+    r = {'line': int(v[0]), 'image': v[1], 'idx': int(v[2]), 'events': 0}
+    for name, value in zip(STAMPS, v[3:]):
+      r[name] = int(value)
+    if 'events' in columns:
+      r['events'] = int(v[columns.index('events')])
+    records.append(r)
+  return header, records
+
+def parse_bin(data):
+  magic, depth, record_size, head, missed, dma_late = struct.unpack_from('<6I', data, 0)
+  if magic != TLM_MAGIC:
+    sys.exit('telemetry magic not found')
+  header = ['# telemetry lines=%d missed_deadline=%d dma_late=%d' % (head, missed, dma_late)]
+  records = []
+  first = max(0, head - depth)
+  for n in range(first, head):
+    offset = 24 + (n % depth) * record_size
+    v = struct.unpack_from('<6IiI', data, offset)
+    r = {'line': n, 'image': str(v[7]), 'idx': v[6], 'events': 0}
+    if record_size >= 36:
+      r['events'] = struct.unpack_from('<I', data, offset + 32)[0]
+    for name, value in zip(STAMPS, v[:6]):
+      r[name] = value
+    records.append(r)
+  return header, records
+
+def read_serial(port):
+  import serial
+  lines = []
+  with serial.Serial(port, timeout=2) as s:
+    print('Waiting for telemetry (press the push switch)...')
+    started = False
+    while True:
+      line = s.readline().decode(errors='replace')
+      if line == '':
+        if started:
+          break
+        continue
+      if line.startswith('# telemetry'):
+        started = True
+        lines = []
+      if started:
+        lines.append(line)
+  return lines
+
+def diff(a, b):
+  # 32bit timer wraps
+  return ((a - b + 0x80000000) & 0xffffffff) - 0x80000000
+
+def percentile(values, pct):
+  if not values:
+    return 0
+  s = sorted(values)
+  return s[min(len(s) - 1, (len(s) * pct + 99) // 100 - 1)]
+
+def main():
+  args = sys.argv[1:]
+  if len(args) == 2 and args[0] == '--bin':
+    header, records = parse_bin(open(args[1], 'rb').read())
+  elif len(args) == 2 and args[0] == '--serial':
+    header, records = parse_csv(read_serial(args[1]))
+  elif len(args) == 1:
+    header, records = parse_csv(open(args[0]).readlines())
+  else:
+    sys.exit('usage: telemetry_plot.py [--bin FILE | --serial PORT | FILE]')
+
+  for line in header:
+    print(line)
+  if not records:
+    sys.exit('no records')
+
+  fetch = [diff(r['fetch_end'], r['fetch_start']) for r in records]
+  pack = [diff(r['pack_end'], r['fetch_end']) for r in records]
+  slack = [diff(r['deadline'], r['pack_end']) for r in records]
+  jitter = [diff(r['dma_start'], r['deadline']) for r in records]
+  dma = [diff(r['dma_done'], r['dma_start']) if r['dma_done'] else 0 for r in records]
+
+  series = [('fetch', fetch), ('pack', pack), ('slack', slack), ('jitter', jitter), ('dma', dma)]
+  print('%d records' % len(records))
+  for name, values in series:
+    print('%-7s p50=%6d p99=%6d max=%6d [us]' % (name, percentile(values, 50), percentile(values, 99), max(values)))
+  print('missed deadlines: %d' % sum(1 for v in slack if v < 0))
+  print('events: ' + ' '.join('%s=%d' % (name, sum(1 for r in records if r['events'] & bit)) for name, bit in EVENTS))
+
+  import matplotlib.pyplot as plt
+  x = [r['line'] for r in records]
+  fig, axes = plt.subplots(2, 1, figsize=(12, 8))
+  axes[0].stackplot(x, fetch, pack, labels=['fetch', 'pack'])
+  axes[0].plot(x, slack, label='slack', color='green')
+  axes[0].plot(x, dma, label='dma', color='gray')
+  axes[0].axhline(0, color='red', linewidth=0.5)
+  axes[0].set_xlabel('line')
+  axes[0].set_ylabel('us')
+  axes[0].legend(loc='upper right')
+  axes[1].hist([pack, slack, dma], bins=64, label=['pack', 'slack', 'dma'], histtype='step')
+  axes[1].set_xlabel('us')
+  axes[1].set_yscale('log')
+  axes[1].legend(loc='upper right')
+  plt.tight_layout()
+  plt.show()
+
+if __name__ == '__main__':
+  main()
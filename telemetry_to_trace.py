@@ -0,0 +1,76 @@
+# telemetry_to_trace.py
+# This script converts per-line telemetry (OREORE_TELEMETRY=ON) into Chrome trace JSON,
+# which shows fetch / pack / slack and DMA of every line on a timeline.
+# Open the output with https://ui.perfetto.dev or chrome://tracing.
+# (oreore_sim run --trace FILE writes the same tracks from the simulator)
+
+# Usage
+# $ python ./telemetry_to_trace.py capture.txt trace.json
+# $ python ./telemetry_to_trace.py --bin telemetry.bin trace.json
+# $ python ./telemetry_to_trace.py --serial /dev/ttyACM0 trace.json
+# (see telemetry_plot.py for capturing)
+
+import json
+import sys
+from telemetry_plot import parse_csv, parse_bin, read_serial, diff
+
+CORE0 = 1
+LINE = 2
+DMA = 3
+IRQ = 4
+TRACKS = [(CORE0, 'core0'), (LINE, 'line'), (DMA, 'dma'), (IRQ, 'irq')]
+
+def convert(records):
+  events = [{'ph': 'M', 'name': 'process_name', 'pid': 1, 'args': {'name': 'oreore_poi'}}]
+  for tid, name in TRACKS:
+    events.append({'ph': 'M', 'name': 'thread_name', 'pid': 1, 'tid': tid, 'args': {'name': name}})
+    events.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': 1, 'tid': tid, 'args': {'sort_index': tid}})
+
+  def span(tid, name, ts, dur, args=None):
+    events.append({'name': name, 'ph': 'X', 'ts': ts, 'dur': max(dur, 0), 'pid': 1, 'tid': tid, 'args': args or {}})
+
+  def instant(tid, name, ts, args=None):
+    events.append({'name': name, 'ph': 'i', 's': 't', 'ts': ts, 'pid': 1, 'tid': tid, 'args': args or {}})
+
+  # 32bit us timestamps are unwrapped relative to the first record
+  base = records[0]['fetch_start']
+  origin = 0
+  prev = None
+  for r in records:
+    if prev is not None:
+      origin += diff(r['fetch_start'], prev['fetch_start'])
+    t = lambda name: origin + diff(r[name], r['fetch_start'])
+    fetch_start = origin
+    args = {'idx': r['idx'], 'line': r['line']}
+    span(CORE0, 'fetch', fetch_start, t('fetch_end') - fetch_start, args)
+    span(CORE0, 'pack', t('fetch_end'), t('pack_end') - t('fetch_end'), args)
+    late = diff(r['pack_end'], r['deadline']) > 0
+    span(CORE0, 'late' if late else 'slack', t('pack_end'), t('dma_start') - t('pack_end'), args)
+    instant(IRQ, 'deadline', t('deadline'), args)
+    if r['dma_done']:
+      span(DMA, 'dma', t('dma_start'), t('dma_done') - t('dma_start'), args)
+      instant(IRQ, 'dma_irq', t('dma_done'))
+    span(LINE, r['image'], fetch_start, t('dma_start') - fetch_start, args)
+    prev = r
+  return {'displayTimeUnit': 'ms', 'traceEvents': events, 'otherData': {'time_origin_us': base}}
+
+def main():
+  args = sys.argv[1:]
+  if len(args) == 3 and args[0] == '--bin':
+    _, records = parse_bin(open(args[1], 'rb').read())
+  elif len(args) == 3 and args[0] == '--serial':
+    _, records = parse_csv(read_serial(args[1]))
+  elif len(args) == 2:
+    _, records = parse_csv(open(args[0]).readlines())
+  else:
+    sys.exit('usage: telemetry_to_trace.py [--bin FILE | --serial PORT | FILE] OUT.json')
+  if not records:
+    sys.exit('no records')
+
+  trace = convert(records)
+  with open(args[-1], 'w') as f:
+    json.dump(trace, f)
+  print('%d records, %d events written to %s' % (len(records), len(trace['traceEvents']), args[-1]))
+
+if __name__ == '__main__':
+  main()
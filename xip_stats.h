@@ -0,0 +1,93 @@
+// XIP cache hit/miss statistics
+//
+// Enabled by OREORE_XIP_STATS (cmake -DOREORE_XIP_STATS=ON).
+// XIP_CTRL CTR_HIT / CTR_ACC are cleared before fetch and pack of each line and read after it, and the
+// counts are attributed to the active image and its playback phase. The counters saturate at 2^32
+// (within minutes with code running from flash), so deltas of free-running values are not used.
+// Note: counters include instruction fetches of the code running from flash during the window.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+enum xip_phase {
+    XIP_PHASE_FIRST_FWD = 0,    // first pass after the push switch is released
+    XIP_PHASE_FIRST_BACK,       // first pass, mirrored half
+    XIP_PHASE_REPEAT_FWD,       // 2nd and later passes (loop)
+    XIP_PHASE_REPEAT_BACK,      // 2nd and later passes, mirrored half
+    XIP_NUM_PHASES
+};
+
+static inline xip_phase get_xip_phase(const uint32_t pass, const bool backward){
+    if(pass == 0){
+        return backward ? XIP_PHASE_FIRST_BACK : XIP_PHASE_FIRST_FWD;
+    }
+    return backward ? XIP_PHASE_REPEAT_BACK : XIP_PHASE_REPEAT_FWD;
+}
+
+#if OREORE_XIP_STATS
+
+#include "hardware/structs/xip_ctrl.h"
+
+const uint32_t XIP_STATS_MAX_IMAGES = 8;
+
+struct xip_counts {
+    uint32_t lines;
+    uint64_t hit;
+    uint64_t acc;
+};
+
+struct xip_stats {
+    xip_counts counts[XIP_STATS_MAX_IMAGES][XIP_NUM_PHASES] = {};
+
+    void begin(){
+        // Any write clears the counter
+        xip_ctrl_hw->ctr_hit = 0;
+        xip_ctrl_hw->ctr_acc = 0;
+    }
+
+    void end(const uint32_t image, const xip_phase phase){
+        const uint32_t hit = xip_ctrl_hw->ctr_hit;
+        const uint32_t acc = xip_ctrl_hw->ctr_acc;
+        if(image >= XIP_STATS_MAX_IMAGES){
+            return;
+        }
+        auto & c = counts[image][phase];
+        c.lines++;
+        c.hit += hit;
+        c.acc += acc;
+    }
+};
+
+xip_stats xip_stat;
+
+void xip_stats_dump(const char * const * image_names, const uint32_t num_images){
+    static const char * phase_names[XIP_NUM_PHASES] = {"first_fwd", "first_back", "repeat_fwd", "repeat_back"};
+    printf("# xip cache\n");
+    printf("image,phase,lines,access,hit,hit_rate\n");
+    for(uint32_t i=0;i<num_images && i<XIP_STATS_MAX_IMAGES;i++){
+        for(uint32_t p=0;p<XIP_NUM_PHASES;p++){
+            const auto & c = xip_stat.counts[i][p];
+            if(c.lines == 0){
+                continue;
+            }
+            const auto permil = c.acc ? static_cast<uint32_t>(c.hit * 1000 / c.acc) : 1000;
+            printf("%s,%s,%lu,%llu,%llu,%lu.%lu%%\n", image_names[i], phase_names[p], (unsigned long)c.lines,
+                (unsigned long long)c.acc, (unsigned long long)c.hit,
+                (unsigned long)(permil / 10), (unsigned long)(permil % 10));
+        }
+    }
+}
+
+#define XIP_STATS_BEGIN() xip_stat.begin()
+#define XIP_STATS_END(image, phase) xip_stat.end((image), (phase))
+#define XIP_STATS_DUMP(names, num) xip_stats_dump((names), (num))
+
+#else
+
+#define XIP_STATS_BEGIN() ((void)0)
+#define XIP_STATS_END(image, phase) ((void)0)
+#define XIP_STATS_DUMP(names, num) ((void)0)
+
+#endif